@@ -0,0 +1,473 @@
+#include "batch.h"
+#include "trace.h"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Ячейка окна: файл paths[file] читается в собственный буфер ячейки.
+// Буфер сохраняется между файлами и только растет.
+struct BatchReader::Slot {
+    size_t file = 0;
+    int fd = -1;
+    unique_ptr<char[]> buffer;
+    size_t capacity = 0;
+    size_t filled = 0;
+    int error = 0;
+    bool done = false;
+    
+    static constexpr size_t INITIAL_CAPACITY = 64 * 1024;
+    
+    void reset(size_t index) {
+        file = index;
+        fd = -1;
+        filled = 0;
+        error = 0;
+        done = false;
+        if (!buffer) reserve(INITIAL_CAPACITY);
+    }
+    
+    void reserve(size_t size) {
+        if (size <= capacity) return;
+        unique_ptr<char[]> grown(new char[size]);
+        memcpy(grown.get(), buffer.get(), filled);
+        buffer = move(grown);
+        capacity = size;
+    }
+    
+    void finish(int code) {
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+        error = code;
+        done = true;
+    }
+    
+    // Блокирующее чтение файла целиком до read(), вернувшего 0;
+    // результат — errno или 0
+    int load(const string& path) {
+        fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return errno;
+        struct stat info;
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+            reserve(static_cast<size_t>(info.st_size) + 1);
+        }
+        while (true) {
+            if (filled == capacity) reserve(capacity * 2);
+            ssize_t received = read(fd, buffer.get() + filled, capacity - filled);
+            if (received < 0 && errno == EINTR) continue;
+            if (received < 0) return errno;
+            if (received == 0) return 0;
+            filled += static_cast<size_t>(received);
+        }
+    }
+};
+
+// Кольца io_uring, отображенные в память процесса
+struct BatchReader::Ring {
+    int fd = -1;
+    
+    void* sqMemory = MAP_FAILED;
+    size_t sqSize = 0;
+    void* cqMemory = MAP_FAILED;
+    size_t cqSize = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqesSize = 0;
+    
+    unsigned* sqTail = nullptr;
+    unsigned sqMask = 0;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+    
+    unsigned localTail = 0; // хвост с заполненными, но не опубликованными запросами
+    unsigned pending = 0;   // заполнено, но еще не отправлено в ядро
+    unsigned inFlight = 0;  // отправлено в ядро и еще не завершено
+    
+    ~Ring() {
+        if (sqes != MAP_FAILED) munmap(sqes, sqesSize);
+        if (cqMemory != MAP_FAILED && cqMemory != sqMemory) munmap(cqMemory, cqSize);
+        if (sqMemory != MAP_FAILED) munmap(sqMemory, sqSize);
+        if (fd >= 0) close(fd);
+    }
+    
+    bool setup(unsigned entries) {
+        io_uring_params params{};
+        fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) return false;
+        
+        sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) sqSize = cqSize = max(sqSize, cqSize);
+        
+        sqMemory = mmap(nullptr, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        fd, IORING_OFF_SQ_RING);
+        if (sqMemory == MAP_FAILED) return false;
+        cqMemory = single ? sqMemory
+                          : mmap(nullptr, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                 fd, IORING_OFF_CQ_RING);
+        if (cqMemory == MAP_FAILED) return false;
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                                               MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+        if (sqes == MAP_FAILED) return false;
+        
+        char* sq = static_cast<char*>(sqMemory);
+        char* cq = static_cast<char*>(cqMemory);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        localTail = *sqTail;
+        
+        // Чтение идет с текущей позиции файла (смещение -1), как read():
+        // так читаются и каналы, у которых смещения нет. Открытие и чтение
+        // через кольцо есть не во всех ядрах, и без них каждый файл
+        // завершился бы ошибкой, поэтому операции проверяются заранее.
+        return (params.features & IORING_FEAT_RW_CUR_POS) &&
+               supports(IORING_OP_OPENAT) && supports(IORING_OP_READ);
+    }
+    
+    bool supports(unsigned opcode) const {
+        const unsigned maxOps = 256;
+        vector<uint64_t> storage((sizeof(io_uring_probe) + maxOps * sizeof(io_uring_probe_op) +
+                                  sizeof(uint64_t) - 1) / sizeof(uint64_t));
+        io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(storage.data());
+        if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, maxOps) < 0) {
+            return false;
+        }
+        return opcode <= probe->last_op && (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED);
+    }
+    
+    // Запросов в полете не больше числа ячеек окна, поэтому место
+    // в кольце отправки есть всегда
+    io_uring_sqe* nextEntry() {
+        unsigned index = localTail++ & sqMask;
+        io_uring_sqe* entry = &sqes[index];
+        memset(entry, 0, sizeof(*entry));
+        sqArray[index] = index;
+        pending++;
+        return entry;
+    }
+    
+    // Отправка накопленных запросов; при wait — ожидание хотя бы одного
+    // завершения
+    bool enter(bool wait) {
+        if (!pending && !wait) return true;
+        __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+        while (true) {
+            long result = syscall(__NR_io_uring_enter, fd, pending, wait ? 1 : 0,
+                                  wait ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+            if (result >= 0) {
+                pending -= static_cast<unsigned>(result);
+                inFlight += static_cast<unsigned>(result);
+                return true;
+            }
+            if (errno != EINTR) return false;
+        }
+    }
+    
+    template <typename F>
+    void reap(F&& onCompletion) {
+        unsigned head = *cqHead;
+        unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            const io_uring_cqe& completion = cqes[head & cqMask];
+            inFlight--;
+            onCompletion(completion.user_data, completion.res);
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    }
+    
+    // Ожидание всех отправленных запросов: пока они не завершены, ядро
+    // может писать в буферы ячеек. false — кольцо не отвечает и на это.
+    template <typename F>
+    bool drain(F&& onCompletion) {
+        for (int failures = 0; inFlight && failures < 3;) {
+            long result = syscall(__NR_io_uring_enter, fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (result < 0 && errno != EINTR) failures++;
+            reap(onCompletion);
+        }
+        return inFlight == 0;
+    }
+};
+
+BatchReader::BatchReader(size_t depth, Backend preferred)
+    : slots(max<size_t>(depth, 1)), fallback(preferred) {
+    if (preferred == Backend::IO_URING) {
+        // Пул потоков читает одновременно с трансляцией, но на одном ядре
+        // только добавляет переключения и медленнее чтения по очереди
+        fallback = thread::hardware_concurrency() > 1 ? Backend::THREADS : Backend::SEQUENTIAL;
+        ring = make_unique<Ring>();
+        if (!ring->setup(static_cast<unsigned>(slots.size()))) {
+            ring.reset();
+        }
+    }
+}
+
+BatchReader::~BatchReader() = default;
+
+BatchReader::Backend BatchReader::backend() const {
+    return ring ? Backend::IO_URING : fallback;
+}
+
+const char* BatchReader::backendName() const {
+    switch (backend()) {
+        case Backend::IO_URING: return "io_uring";
+        case Backend::THREADS: return "пул потоков";
+        case Backend::SEQUENTIAL: break;
+    }
+    return "последовательно";
+}
+
+void BatchReader::readAll(const vector<string>& paths, const LoadedFileHandler& handler) {
+    if (ring) {
+        readWithRing(paths, handler);
+    } else {
+        readWithoutRing(paths, handler);
+    }
+}
+
+void BatchReader::readWithoutRing(const vector<string>& paths, const LoadedFileHandler& handler) {
+    if (fallback == Backend::THREADS) {
+        readWithThreads(paths, handler);
+    } else {
+        readSequentially(paths, handler);
+    }
+}
+
+// Этап запроса хранится в младшем бите user_data, номер ячейки — в остальных
+enum : uint64_t { STAGE_OPEN = 0, STAGE_READ = 1 };
+
+void BatchReader::readWithRing(const vector<string>& paths, const LoadedFileHandler& handler) {
+    Ring& queue = *ring;
+    size_t depth = slots.size();
+    
+    auto submitOpen = [&](size_t slotIndex) {
+        io_uring_sqe* entry = queue.nextEntry();
+        entry->opcode = IORING_OP_OPENAT;
+        entry->fd = AT_FDCWD;
+        entry->addr = reinterpret_cast<uint64_t>(paths[slots[slotIndex].file].c_str());
+        entry->open_flags = O_RDONLY | O_CLOEXEC;
+        entry->user_data = slotIndex << 1 | STAGE_OPEN;
+    };
+    
+    auto submitRead = [&](size_t slotIndex) {
+        Slot& slot = slots[slotIndex];
+        io_uring_sqe* entry = queue.nextEntry();
+        entry->opcode = IORING_OP_READ;
+        entry->fd = slot.fd;
+        entry->addr = reinterpret_cast<uint64_t>(slot.buffer.get() + slot.filled);
+        entry->len = static_cast<uint32_t>(min<size_t>(slot.capacity - slot.filled, UINT32_MAX));
+        entry->off = UINT64_MAX; // с текущей позиции
+        entry->user_data = slotIndex << 1 | STAGE_READ;
+    };
+    
+    auto onCompletion = [&](uint64_t userData, int result) {
+        size_t slotIndex = static_cast<size_t>(userData >> 1);
+        Slot& slot = slots[slotIndex];
+        if (result < 0) {
+            slot.finish(-result);
+            return;
+        }
+        if ((userData & 1) == STAGE_OPEN) {
+            slot.fd = result;
+            submitRead(slotIndex);
+            return;
+        }
+        // Конец файла — только чтение, вернувшее 0: неполное чтение
+        // возможно и у обычного файла, а у канала обычно. Заполненный
+        // до конца буфер удваивается.
+        if (result == 0) {
+            slot.finish(0);
+            return;
+        }
+        slot.filled += static_cast<size_t>(result);
+        if (slot.filled == slot.capacity) slot.reserve(slot.capacity * 2);
+        submitRead(slotIndex);
+    };
+    
+    size_t started = 0;
+    for (; started < paths.size() && started < depth; started++) {
+        slots[started].reset(started);
+        submitOpen(started);
+    }
+    
+    for (size_t next = 0; next < paths.size(); next++) {
+        Slot& slot = slots[next % depth];
+        if (!slot.done) {
+            TRACE_SCOPE("io wait");
+            while (!slot.done) {
+                if (!queue.enter(true)) {
+                    // Кольцо отказало: оставшиеся файлы читаются без него.
+                    // Сначала дожидаемся запросов в ядре (открытые ими
+                    // файлы закрываются); если и это не удалось, буферы
+                    // ячеек не переиспользуются — в них еще может писать ядро.
+                    bool drained = queue.drain([](uint64_t userData, int result) {
+                        if ((userData & 1) == STAGE_OPEN && result >= 0) close(result);
+                    });
+                    for (Slot& pendingSlot : slots) {
+                        if (pendingSlot.fd >= 0) close(pendingSlot.fd);
+                        pendingSlot.fd = -1;
+                        if (!drained) {
+                            (void)pendingSlot.buffer.release();
+                            pendingSlot.capacity = 0;
+                            pendingSlot.filled = 0;
+                        }
+                    }
+                    ring.reset();
+                    readWithoutRing(vector<string>(paths.begin() + next, paths.end()), handler);
+                    return;
+                }
+                queue.reap(onCompletion);
+            }
+        }
+        
+        handler(LoadedFile{paths[next], string_view(slot.buffer.get(), slot.filled), slot.error});
+        
+        // Ячейка освободилась: в нее сразу ставится следующий файл окна
+        if (started < paths.size()) {
+            slot.reset(started++);
+            submitOpen(next % depth);
+        }
+        // Запросы отправляются пачками, но до того, как окно опустеет
+        if (queue.pending >= max<size_t>(depth / 8, 1)) {
+            queue.enter(false);
+        }
+        queue.reap(onCompletion);
+    }
+}
+
+void BatchReader::readWithThreads(const vector<string>& paths, const LoadedFileHandler& handler) {
+    size_t depth = slots.size();
+    mutex lock;
+    condition_variable changed;
+    size_t nextToRead = 0;
+    size_t delivered = 0;
+    for (Slot& slot : slots) {
+        slot.file = SIZE_MAX;
+        slot.done = false;
+    }
+    
+    // Чтение в основном ожидает диск, поэтому потоков больше, чем ядер
+    unsigned threadCount = static_cast<unsigned>(min<size_t>(depth, max(4u, thread::hardware_concurrency())));
+    
+    auto work = [&] {
+        unique_lock<mutex> guard(lock);
+        while (true) {
+            // Файл берется, только когда его ячейка уже отдана обработчику
+            changed.wait(guard, [&] {
+                return nextToRead >= paths.size() || nextToRead < delivered + depth;
+            });
+            if (nextToRead >= paths.size()) return;
+            size_t file = nextToRead++;
+            Slot& slot = slots[file % depth];
+            slot.reset(file);
+            guard.unlock();
+            
+            int code = slot.load(paths[file]);
+            
+            guard.lock();
+            slot.finish(code);
+            changed.notify_all();
+        }
+    };
+    
+    vector<thread> threads;
+    for (unsigned i = 0; i < threadCount; i++) {
+        threads.emplace_back(work);
+    }
+    
+    for (size_t next = 0; next < paths.size(); next++) {
+        Slot& slot = slots[next % depth];
+        {
+            unique_lock<mutex> guard(lock);
+            if (!(slot.file == next && slot.done)) {
+                TRACE_SCOPE("io wait");
+                changed.wait(guard, [&] { return slot.file == next && slot.done; });
+            }
+        }
+        
+        handler(LoadedFile{paths[next], string_view(slot.buffer.get(), slot.filled), slot.error});
+        
+        lock_guard<mutex> guard(lock);
+        delivered = next + 1;
+        changed.notify_all();
+    }
+    
+    for (thread& worker : threads) {
+        worker.join();
+    }
+}
+
+void BatchReader::readSequentially(const vector<string>& paths, const LoadedFileHandler& handler) {
+    Slot& slot = slots[0];
+    for (size_t next = 0; next < paths.size(); next++) {
+        slot.reset(next);
+        {
+            // Трансляция ждет чтения так же, как ждала бы кольцо или пул
+            TRACE_SCOPE("io wait");
+            slot.finish(slot.load(paths[next]));
+        }
+        handler(LoadedFile{paths[next], string_view(slot.buffer.get(), slot.filled), slot.error});
+    }
+}
+
+bool isProgramName(string_view name) {
+    return !name.empty() && name.front() != '.' && name.back() != '~';
+}
+
+vector<string> expandPaths(const vector<string>& paths) {
+    vector<string> files;
+    for (const string& path : paths) {
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0 || !S_ISDIR(info.st_mode)) {
+            files.push_back(path);
+            continue;
+        }
+        
+        DIR* handle = opendir(path.c_str());
+        if (!handle) {
+            files.push_back(path);
+            continue;
+        }
+        string prefix = path.back() == '/' ? path : path + "/";
+        vector<string> names;
+        while (dirent* entry = readdir(handle)) {
+            if (!isProgramName(entry->d_name)) continue;
+            // Тип из каталога доступен не во всех файловых системах
+            bool regular = entry->d_type == DT_REG;
+            if (entry->d_type == DT_UNKNOWN) {
+                struct stat entryInfo;
+                regular = stat((prefix + entry->d_name).c_str(), &entryInfo) == 0 &&
+                          S_ISREG(entryInfo.st_mode);
+            }
+            if (regular) names.push_back(entry->d_name);
+        }
+        closedir(handle);
+        
+        sort(names.begin(), names.end());
+        for (const string& name : names) {
+            files.push_back(prefix + name);
+        }
+    }
+    return files;
+}
@@ -0,0 +1,75 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Пакетное чтение множества файлов для трансляции. Одновременно читается
+// окно из depth файлов: открытие и чтение отправляются пачками в io_uring
+// (системные вызовы напрямую, без liburing), а если io_uring недоступен —
+// выполняются пулом потоков; на одном ядре пул только добавляет
+// переключения, и файлы читаются по очереди в вызывающем потоке.
+// Буферы окна переиспользуются от файла к файлу.
+// Файлы отдаются обработчику в порядке списка, как только готов очередной,
+// поэтому чтение следующих файлов идет одновременно с трансляцией текущего.
+
+// Прочитанный файл. Текст лежит в буфере пула и действителен
+// только до возврата из обработчика.
+struct LoadedFile {
+    const std::string& path;
+    std::string_view text;
+    int error; // errno при открытии или чтении, 0 — успех
+};
+
+using LoadedFileHandler = std::function<void(const LoadedFile&)>;
+
+class BatchReader {
+public:
+    enum class Backend {
+        IO_URING,  // кольца отправки и завершения io_uring
+        THREADS,   // переносимый пул потоков с блокирующим чтением
+        SEQUENTIAL // блокирующее чтение в вызывающем потоке
+    };
+    
+    static constexpr size_t DEFAULT_DEPTH = 64;
+    
+    // Если io_uring недоступен (старое ядро без открытия и чтения через
+    // кольцо, запрет в контейнере), используется пул потоков, а на одном
+    // ядре — последовательное чтение
+    explicit BatchReader(size_t depth = DEFAULT_DEPTH, Backend preferred = Backend::IO_URING);
+    ~BatchReader();
+    
+    BatchReader(const BatchReader&) = delete;
+    BatchReader& operator=(const BatchReader&) = delete;
+    
+    Backend backend() const;
+    const char* backendName() const;
+    
+    void readAll(const std::vector<std::string>& paths, const LoadedFileHandler& handler);
+
+private:
+    struct Slot;
+    struct Ring;
+    
+    std::vector<Slot> slots;
+    std::unique_ptr<Ring> ring;
+    Backend fallback; // чтение без кольца
+    
+    void readWithRing(const std::vector<std::string>& paths, const LoadedFileHandler& handler);
+    void readWithThreads(const std::vector<std::string>& paths, const LoadedFileHandler& handler);
+    void readSequentially(const std::vector<std::string>& paths, const LoadedFileHandler& handler);
+    void readWithoutRing(const std::vector<std::string>& paths, const LoadedFileHandler& handler);
+};
+
+// Временные и скрытые файлы редакторов не считаются программами
+bool isProgramName(std::string_view name);
+
+// Замена каталогов в списке путей их обычными файлами (по алфавиту,
+// без скрытых и резервных копий редакторов)
+std::vector<std::string> expandPaths(const std::vector<std::string>& paths);
+
+#endif // BATCH_H
@@ -0,0 +1,692 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <unordered_set>
+#include <thread>
+#include <fstream>
+#include <cstdio>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "scanner.h"
+#include "parser.h"
+#include "semantic.h"
+#include "dispatch.h"
+#include "profile.h"
+#include "compiler.h"
+#include "libswitch.h"
+#include "image.h"
+#include "lazy.h"
+#include "batch.h"
+#include "trace.h"
+#include "latency.h"
+#include "error_handler.h"
+
+using namespace std;
+
+// Поток, отбрасывающий весь вывод (чтобы измерять обход, а не терминал)
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    streamsize xsputn(const char*, streamsize n) override { return n; }
+};
+
+// Генерация программы с заданным числом case и действий в каждом
+static string generateProgram(int caseCount, int actionsPerCase) {
+    ostringstream out;
+    out << "switch (I) {\n";
+    for (int i = 0; i < caseCount; i++) {
+        out << "    case " << i << ":\n";
+        for (int j = 0; j < actionsPerCase; j++) {
+            out << "        print(\"Case " << i << " action " << j << "\");\n";
+        }
+        out << "        break;\n";
+    }
+    out << "    default:\n        print(\"По умолчанию\");\n}\n";
+    return out.str();
+}
+
+template <typename F>
+static double measureMs(F&& f) {
+    auto begin = chrono::steady_clock::now();
+    f();
+    auto end = chrono::steady_clock::now();
+    return chrono::duration<double, milli>(end - begin).count();
+}
+
+static void report(const string& name, double ms, size_t nodes) {
+    cout << "  " << name << ": " << ms << " мс ("
+         << (ms * 1e6 / nodes) << " нс/узел)" << endl;
+}
+
+// Обход большого AST: анализ, печать и выполнение
+static void benchTraversal(int caseCount, int actionsPerCase, int executions) {
+    string source = generateProgram(caseCount, actionsPerCase);
+    size_t nodes = 1 + static_cast<size_t>(caseCount) * (1 + actionsPerCase) + 2;
+    
+    cout << "Обход AST: " << caseCount << " case x " << actionsPerCase
+         << " действий (" << nodes << " узлов)" << endl;
+    
+    ErrorHandler::getInstance().clear();
+    Scanner scanner(source);
+    Parser parser(scanner);
+    unique_ptr<ASTNode> ast;
+    report("разбор", measureMs([&] { ast = parser.parse(); }), nodes);
+    
+    SemanticAnalyzer semantic;
+    report("анализ", measureMs([&] { semantic.analyze(ast); }), nodes);
+    
+    NullBuffer nullBuffer;
+    streambuf* saved = cout.rdbuf(&nullBuffer);
+    double printMs = measureMs([&] { ast->print(); });
+    double executeMs = measureMs([&] {
+        for (int i = 0; i < executions; i++) {
+            semantic.execute(ast, (i * 7919) % (caseCount + 1));
+        }
+    });
+    cout.rdbuf(saved);
+    
+    report("печать", printMs, nodes);
+    cout << "  выполнение: " << executeMs / executions << " мс на вызов" << endl;
+}
+
+// Время одного поиска ключа для заданной стратегии (нс)
+static double measureLookup(const vector<int32_t>& keys, const vector<int32_t>& probes,
+                            DispatchKind kind, bool scalar) {
+    CaseDispatcher dispatcher;
+    dispatcher.build(keys, kind);
+    
+    // Для скалярного варианта повторяем раскладку блоков CaseDispatcher
+    vector<KeyBlock> blocks((keys.size() + 7) / 8);
+    for (size_t i = 0; i < blocks.size() * 8; i++) {
+        blocks[i / 8].lanes[i % 8] = i < keys.size() ? keys[i] : keys[0];
+    }
+    
+    const int rounds = 50;
+    volatile uint32_t sink = 0;
+    double ms = measureMs([&] {
+        for (int r = 0; r < rounds; r++) {
+            for (int32_t probe : probes) {
+                sink = sink + (scalar ? findKeyScalar(blocks.data(), keys.size(), probe)
+                                      : dispatcher.find(probe));
+            }
+        }
+    });
+    return ms * 1e6 / (static_cast<double>(rounds) * probes.size());
+}
+
+// Сравнение стратегий выбора case; по нему подобран LINEAR_THRESHOLD
+static void benchDispatch() {
+    cout << "Выбор case (нс/поиск), векторное ядро: " << vectorKernelName() << endl;
+    cout << "  ключей  скаляр  вектор  хеш     таблица" << endl;
+    
+    mt19937 random(42);
+    for (size_t count : {8, 16, 32, 64, 96, 128, 192, 256, 512, 1024}) {
+        // Разреженные ключи: таблица переходов неприменима
+        unordered_set<int32_t> unique;
+        while (unique.size() < count) {
+            unique.insert(static_cast<int32_t>(random() % 1000000));
+        }
+        vector<int32_t> keys(unique.begin(), unique.end());
+        
+        // Половина обращений попадает в case, половина уходит в default
+        vector<int32_t> probes(4096);
+        for (size_t i = 0; i < probes.size(); i++) {
+            probes[i] = i % 2 ? keys[random() % count] : static_cast<int32_t>(random() % 1000000);
+        }
+        
+        vector<int32_t> dense(count);
+        for (size_t i = 0; i < count; i++) dense[i] = static_cast<int32_t>(i);
+        shuffle(dense.begin(), dense.end(), random);
+        vector<int32_t> denseProbes(probes.size());
+        for (size_t i = 0; i < denseProbes.size(); i++) {
+            denseProbes[i] = static_cast<int32_t>(random() % (count * 2));
+        }
+        
+        cout << "  " << count
+             << "\t " << measureLookup(keys, probes, DispatchKind::LINEAR, true)
+             << "\t " << measureLookup(keys, probes, DispatchKind::LINEAR, false)
+             << "\t " << measureLookup(keys, probes, DispatchKind::HASH, false)
+             << "\t " << measureLookup(dense, denseProbes, DispatchKind::JUMP_TABLE, false)
+             << endl;
+    }
+}
+
+// Выбор case при перекосе нагрузки: 95% обращений к 8 ключам из 100000.
+// Сравнивается компиляция без профиля и с профилем (горячий префикс).
+static void benchProfile() {
+    const int caseCount = 100000;
+    mt19937 random(7);
+    vector<int32_t> probes(1 << 16);
+    for (size_t i = 0; i < probes.size(); i++) {
+        probes[i] = random() % 100 < 95 ? static_cast<int32_t>(random() % 8) * 4000
+                                        : static_cast<int32_t>(random() % (caseCount * 4));
+    }
+    
+    // Ключи разрежены (каждый четвертый), чтобы выбиралась хеш-таблица
+    vector<int32_t> keys(caseCount);
+    for (int i = 0; i < caseCount; i++) keys[i] = i * 4;
+    shuffle(keys.begin(), keys.end(), random);
+    
+    CaseProfile profile;
+    for (int32_t probe : probes) profile.addCaseHits("I", probe, 1);
+    
+    // Ключи, упорядоченные по профилю, как это делает Compiler
+    vector<int32_t> hotFirst = keys;
+    stable_sort(hotFirst.begin(), hotFirst.end(), [&](int32_t a, int32_t b) {
+        return profile.caseHits("I", a) > profile.caseHits("I", b);
+    });
+    
+    CaseDispatcher plain;
+    plain.build(keys);
+    CaseDispatcher profiled;
+    profiled.build(hotFirst);
+    profiled.setHotPrefix(8);
+    
+    const int rounds = 50;
+    volatile uint32_t sink = 0;
+    auto perLookup = [&](const CaseDispatcher& dispatcher) {
+        double ms = measureMs([&] {
+            for (int r = 0; r < rounds; r++) {
+                for (int32_t probe : probes) sink = sink + dispatcher.find(probe);
+            }
+        });
+        return ms * 1e6 / (static_cast<double>(rounds) * probes.size());
+    };
+    
+    cout << "Профиль (95% обращений к 8 ключам из " << caseCount << "):" << endl;
+    cout << "  без профиля: " << perLookup(plain) << " нс/поиск" << endl;
+    cout << "  с профилем:  " << perLookup(profiled) << " нс/поиск" << endl;
+}
+
+// Семантический анализ очень большого switch при разном числе потоков
+static void benchAnalysis(int caseCount) {
+    string source = generateProgram(caseCount, 1);
+    ErrorHandler::getInstance().clear();
+    Scanner scanner(source);
+    Parser parser(scanner);
+    unique_ptr<ASTNode> ast;
+    double parseMs = measureMs([&] { ast = parser.parse(); });
+    cout << "Анализ " << caseCount << " case (разбор " << parseMs << " мс):" << endl;
+    
+    // Прогрев: первый проход платит за первое обращение к памяти
+    SemanticAnalyzer().check(*ast);
+    for (unsigned threads : {1u, 2u, 4u}) {
+        SemanticAnalyzer semantic;
+        semantic.setThreadCount(threads);
+        double ms = measureMs([&] { semantic.check(*ast); });
+        cout << "  потоков " << threads << ": " << ms << " мс" << endl;
+    }
+    
+    // Выбор по умолчанию: потоки только при PARALLEL_CASES_PER_THREAD case
+    // на поток и не больше числа ядер
+    SemanticAnalyzer automatic;
+    double automaticMs = measureMs([&] { automatic.check(*ast); });
+    cout << "  по числу ядер (" << thread::hardware_concurrency() << "): " << automaticMs << " мс" << endl;
+    
+    double compileMs = measureMs([&] { Compiler().compile(*ast); });
+    cout << "  компиляция: " << compileMs << " мс" << endl;
+}
+
+// Проверка повторов case на значениях, кратных числу корзин хеш-таблицы
+// такого размера (худший случай для хеш-множества), и на подряд идущих
+static void benchDuplicateCheck(int caseCount) {
+    unordered_set<int32_t> probe;
+    probe.reserve(caseCount);
+    int64_t step = static_cast<int64_t>(probe.bucket_count());
+    
+    for (int64_t keyStep : {int64_t(1), step}) {
+        ostringstream out;
+        out << "switch (I) {\n";
+        for (int i = 0; i < caseCount; i++) {
+            out << "    case " << i * keyStep % INT32_MAX << ": print(\"x\"); break;\n";
+        }
+        out << "    default: print(\"y\");\n}\n";
+        string source = out.str();
+        
+        ErrorHandler errors;
+        Scanner scanner(source);
+        Parser parser(scanner, errors);
+        auto ast = parser.parse();
+        SemanticAnalyzer semantic(errors);
+        semantic.setThreadCount(1);
+        double ms = measureMs([&] { semantic.check(*ast); });
+        cout << "Проверка повторов, " << caseCount << " case с шагом " << keyStep << ": " << ms
+             << " мс (" << errors.getErrors().size() << " ошибок)" << endl;
+    }
+}
+
+// Встраиваемый API: вычисление в буфер из нескольких потоков
+static void benchLibrary(int caseCount, int evaluationsPerThread, int threadCount) {
+    string source = generateProgram(caseCount, 2);
+    vector<SwitchDiagnostic> diagnostics;
+    unique_ptr<SwitchProgram> program;
+    double compileMs = measureMs([&] {
+        program = SwitchProgram::compile(source.data(), source.size(), diagnostics);
+    });
+    if (!program) {
+        cout << "libswitch: ошибка компиляции" << endl;
+        return;
+    }
+    
+    double ms = measureMs([&] {
+        vector<thread> threads;
+        for (int t = 0; t < threadCount; t++) {
+            threads.emplace_back([&, t] {
+                char buffer[256];
+                size_t total = 0;
+                for (int i = 0; i < evaluationsPerThread; i++) {
+                    total += program->evaluate((i * 31 + t) % (caseCount + 1), buffer, sizeof(buffer));
+                }
+                if (total == 0) cout << "";
+            });
+        }
+        for (auto& worker : threads) worker.join();
+    });
+    
+    cout << "libswitch: " << caseCount << " case, компиляция " << compileMs << " мс, "
+         << threadCount << " потоков: "
+         << ms * 1e6 / (static_cast<double>(evaluationsPerThread) * threadCount)
+         << " нс/вычисление (суммарно)" << endl;
+}
+
+// Вычисление по плоскому образу (--workers) в сравнении с CompiledProgram.
+// Ключи через один — хеш-таблица, подряд — таблица переходов.
+static void benchImage(int caseCount, int step) {
+    ostringstream out;
+    out << "switch (I) {\n";
+    for (int i = 0; i < caseCount; i++) {
+        out << "case " << i * step << ": print(\"Case " << i << "\"); break;\n";
+    }
+    out << "default: print(\"По умолчанию\");\n}\n";
+    
+    vector<SwitchDiagnostic> diagnostics;
+    string source = out.str();
+    auto program = SwitchProgram::compile(source.data(), source.size(), diagnostics);
+    if (!program) {
+        cout << "Образ: ошибка компиляции" << endl;
+        return;
+    }
+    
+    vector<KeyBlock> storage = ProgramImage::build(program->compiled());
+    ProgramImage image(storage.data(), storage.size() * sizeof(KeyBlock));
+    if (!image.valid()) {
+        cout << "Образ: некорректный образ" << endl;
+        return;
+    }
+    
+    // Проверка: образ дает тот же вывод, что и исходная программа
+    char expected[256];
+    string actual;
+    size_t mismatches = 0;
+    for (int32_t value = -2; value < caseCount * step + 2; value++) {
+        size_t size = program->evaluate(&value, expected, sizeof(expected));
+        actual.clear();
+        image.evaluate(&value, [&](string_view text) { actual.append(text); actual += '\n'; });
+        if (string(expected, min(size, sizeof(expected))) != actual) mismatches++;
+    }
+    
+    const int evaluations = 2000000;
+    size_t total = 0;
+    double programMs = measureMs([&] {
+        for (int i = 0; i < evaluations; i++) {
+            int32_t value = static_cast<int32_t>(i * 7919LL % (caseCount * step));
+            total += program->evaluate(&value, expected, sizeof(expected));
+        }
+    });
+    double imageMs = measureMs([&] {
+        for (int i = 0; i < evaluations; i++) {
+            int32_t value = static_cast<int32_t>(i * 7919LL % (caseCount * step));
+            image.evaluate(&value, [&](string_view text) { total += text.size(); });
+        }
+    });
+    if (total == 0) cout << "";
+    
+    cout << "Образ: " << caseCount << " case (" << (step == 1 ? "таблица" : "хеш") << "), "
+         << image.header().size << " байт, расхождений " << mismatches << ": программа "
+         << programMs * 1e6 / evaluations << " нс, образ " << imageMs * 1e6 / evaluations
+         << " нс/вычисление" << endl;
+}
+
+// Время до первого результата: индекс заголовков и разбор одного тела
+// в сравнении с полным разбором и анализом
+static void benchLazy(int caseCount, int actionsPerCase) {
+    string source = generateProgram(caseCount, actionsPerCase);
+    string filename = "switch_bench_lazy.tmp";
+    ofstream(filename, ios::binary) << source;
+    int value = caseCount / 2;
+    
+    NullBuffer nullBuffer;
+    streambuf* saved = cout.rdbuf(&nullBuffer);
+    
+    double indexMs = 0;
+    double lazyMs = measureMs([&] {
+        MappedFile file;
+        CaseIndex index;
+        file.open(filename);
+        indexMs = measureMs([&] { index.build(file.text()); });
+        ErrorHandler errors;
+        auto ast = index.parseSelected(value, errors);
+        SemanticAnalyzer semantic(errors);
+        semantic.analyze(ast);
+        semantic.execute(ast, value);
+    });
+    
+    double fullMs = measureMs([&] {
+        ifstream file(filename);
+        ErrorHandler errors;
+        Scanner scanner(file);
+        Parser parser(scanner, errors);
+        auto ast = parser.parse();
+        SemanticAnalyzer semantic(errors);
+        semantic.analyze(ast);
+        semantic.execute(ast, value);
+    });
+    
+    cout.rdbuf(saved);
+    remove(filename.c_str());
+    
+    cout << "Отложенный разбор: " << source.size() / (1024 * 1024) << " МБ, " << caseCount
+         << " case: индекс " << indexMs << " мс, до результата " << lazyMs
+         << " мс; полный разбор " << fullMs << " мс" << endl;
+}
+
+// Разбор испорченного текста: каждый case без ':' и с мусором в теле.
+// Потоковый сканер восстанавливается перебором токенов, сканер всего
+// текста — переходом по индексу позиций case/default/'}'
+static void benchRecovery(int caseCount, size_t maxErrors) {
+    ostringstream out;
+    out << "switch (I) {\n";
+    for (int i = 0; i < caseCount; i++) {
+        out << "    case " << i << "\n";
+        out << "        print(\"Case " << i << "\") ) ( 17 I I print(\"мусор\");\n";
+        out << "        break;\n";
+    }
+    out << "    default:\n        print(\"По умолчанию\");\n}\n";
+    string source = out.str();
+    
+    auto parse = [&](Scanner& scanner, size_t& errorCount) {
+        ErrorHandler errors;
+        errors.setMaxErrors(maxErrors);
+        Parser parser(scanner, errors);
+        auto ast = parser.parse();
+        errorCount = errors.getErrors().size();
+    };
+    
+    size_t tokenErrors = 0;
+    double tokenMs = measureMs([&] {
+        size_t offset = 0;
+        Scanner scanner([&](char* buffer, size_t capacity) {
+            size_t size = min(capacity, source.size() - offset);
+            source.copy(buffer, size, offset);
+            offset += size;
+            return size;
+        });
+        parse(scanner, tokenErrors);
+    });
+    
+    size_t indexErrors = 0;
+    double indexMs = measureMs([&] {
+        Scanner scanner(source);
+        parse(scanner, indexErrors);
+    });
+    
+    cout << "Восстановление после ошибок: " << caseCount << " испорченных case, лимит "
+         << (maxErrors ? to_string(maxErrors) : string("нет")) << ": по токенам " << tokenMs
+         << " мс (" << tokenErrors << " ошибок), по индексу " << indexMs << " мс ("
+         << indexErrors << " ошибок)" << endl;
+}
+
+// Цена измерения вычисления: без измерения и с SwitchTiming, записанным
+// в гистограммы задержек
+static void benchLatency(int caseCount, int evaluations) {
+    vector<SwitchDiagnostic> diagnostics;
+    string source = generateProgram(caseCount, 1);
+    auto program = SwitchProgram::compile(source.data(), source.size(), diagnostics);
+    vector<int32_t> values(program->variables().size(), 1);
+    int slot = program->compiled().variableIndex("I");
+    char buffer[256];
+    size_t total = 0;
+    auto perEvaluation = [&](bool timed) {
+        SwitchTiming timing;
+        double ms = measureMs([&] {
+            for (int i = 0; i < evaluations; i++) {
+                values[slot] = i % caseCount;
+                if (!timed) {
+                    total += program->evaluate(values.data(), buffer, sizeof(buffer));
+                    continue;
+                }
+                total += program->evaluate(values.data(), buffer, sizeof(buffer), timing);
+                Latency::record(LatencyKind::EVALUATE, timing.total);
+                Latency::record(LatencyKind::LOOKUP, timing.lookup);
+                Latency::record(LatencyKind::EMIT, timing.emit);
+            }
+        });
+        return ms * 1e6 / evaluations;
+    };
+    
+    double plain = perEvaluation(false);
+    double timed = perEvaluation(true);
+    cout << "Гистограммы задержек (" << caseCount << " case): без измерения " << plain
+         << " нс/вычисление, с SwitchTiming и записью " << timed << " нс/вычисление" << endl;
+    Latency::write(cout);
+}
+
+// Входы, найденные make fuzz (каталог regressions): время разбора
+// на байт должно оставаться того же порядка, что у обычных программ
+static void benchRegressions(const string& directory) {
+    struct stat info;
+    if (stat(directory.c_str(), &info) != 0 || !S_ISDIR(info.st_mode)) return;
+    
+    for (const string& path : expandPaths({directory})) {
+        ifstream file(path, ios::binary);
+        string source((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+        if (source.empty()) continue;
+        
+        double fullMs = measureMs([&] {
+            ErrorHandler errors;
+            Scanner scanner(source);
+            Parser parser(scanner, errors);
+            auto ast = parser.parse();
+            if (!errors.hasErrors()) {
+                SemanticAnalyzer semantic(errors);
+                semantic.analyze(ast);
+            }
+        });
+        double lazyMs = measureMs([&] {
+            CaseIndex index;
+            if (!index.build(source)) return;
+            ErrorHandler errors;
+            auto ast = index.parseSelected(1, errors);
+        });
+        
+        cout << "Регрессия " << path << ": " << source.size() << " байт, полный разбор "
+             << fullMs * 1e6 / source.size() << " нс/байт, отложенный "
+             << lazyMs * 1e6 / source.size() << " нс/байт" << endl;
+    }
+}
+
+// Трансляция каталога из множества небольших файлов: по одному через
+// ifstream и пакетное чтение (io_uring и пул потоков)
+static void benchBatch(int fileCount) {
+    string directory = "switch_bench_batch.tmp";
+    mkdir(directory.c_str(), 0755);
+    vector<string> paths;
+    for (int i = 0; i < fileCount; i++) {
+        paths.push_back(directory + "/" + to_string(i) + ".txt");
+        ofstream(paths.back(), ios::binary) << generateProgram(8 + i % 16, 2);
+    }
+    
+    auto translate = [](Scanner& scanner) {
+        ErrorHandler errors;
+        Parser parser(scanner, errors);
+        auto ast = parser.parse();
+        SemanticAnalyzer semantic(errors);
+        semantic.analyze(ast);
+        semantic.execute(ast, 3);
+    };
+    
+    NullBuffer nullBuffer;
+    streambuf* saved = cout.rdbuf(&nullBuffer);
+    
+    double streamMs = measureMs([&] {
+        for (const string& path : paths) {
+            ifstream file(path);
+            Scanner scanner(file);
+            translate(scanner);
+        }
+    });
+    
+    auto batched = [&](BatchReader::Backend backend, const char*& name) {
+        BatchReader reader(BatchReader::DEFAULT_DEPTH, backend);
+        name = reader.backendName();
+        return measureMs([&] {
+            reader.readAll(paths, [&](const LoadedFile& file) {
+                Scanner scanner{string(file.text)};
+                translate(scanner);
+            });
+        });
+    };
+    const char* ringName = nullptr;
+    const char* threadsName = nullptr;
+    const char* sequentialName = nullptr;
+    double ringMs = batched(BatchReader::Backend::IO_URING, ringName);
+    double threadsMs = batched(BatchReader::Backend::THREADS, threadsName);
+    double sequentialMs = batched(BatchReader::Backend::SEQUENTIAL, sequentialName);
+    
+    cout.rdbuf(saved);
+    for (const string& path : paths) {
+        remove(path.c_str());
+    }
+    rmdir(directory.c_str());
+    
+    auto filesPerSecond = [&](double ms) { return static_cast<long>(fileCount * 1000.0 / ms); };
+    cout << "Пакетная трансляция " << fileCount << " файлов (файлов/с): ifstream "
+         << filesPerSecond(streamMs) << ", " << ringName << " " << filesPerSecond(ringMs)
+         << ", " << threadsName << " " << filesPerSecond(threadsMs)
+         << ", " << sequentialName << " " << filesPerSecond(sequentialMs) << endl;
+}
+
+// Пересекающиеся правила: в группе из depth case каждый следующий
+// выполняет хвост действий предыдущего. С проваливанием тела групп —
+// суффиксы одного отрезка; без него каждый case повторяет свой хвост.
+static void benchFallthrough(int groupCount, int depth) {
+    ostringstream shared;
+    ostringstream copied;
+    shared << "switch (I) {\n";
+    copied << "switch (I) {\n";
+    for (int g = 0; g < groupCount; g++) {
+        for (int c = 0; c < depth; c++) {
+            int key = g * depth + c;
+            shared << "    case " << key << ":\n        print(\"Правило " << key << "\");\n";
+            if (c + 1 == depth) shared << "        break;\n";
+            copied << "    case " << key << ":\n";
+            for (int k = c; k < depth; k++) {
+                copied << "        print(\"Правило " << g * depth + k << "\");\n";
+            }
+            copied << "        break;\n";
+        }
+    }
+    shared << "    default:\n        print(\"По умолчанию\");\n}\n";
+    copied << "    default:\n        print(\"По умолчанию\");\n}\n";
+    
+    auto compile = [](const string& source, CompiledProgram& program) {
+        return measureMs([&] {
+            ErrorHandler errors;
+            Scanner scanner(source);
+            Parser parser(scanner, errors);
+            auto ast = parser.parse();
+            SemanticAnalyzer semantic(errors);
+            semantic.analyze(ast);
+            program = semantic.takeProgram();
+        });
+    };
+    CompiledProgram sharedProgram;
+    CompiledProgram copiedProgram;
+    double sharedMs = compile(shared.str(), sharedProgram);
+    double copiedMs = compile(copied.str(), copiedProgram);
+    
+    cout << "Проваливание (" << groupCount << " групп по " << depth << " case): действий "
+         << sharedProgram.actions.size() << " против " << copiedProgram.actions.size()
+         << ", текст " << shared.str().size() / 1024 << " КБ против " << copied.str().size() / 1024
+         << " КБ, разбор и компиляция " << sharedMs << " мс против " << copiedMs << " мс" << endl;
+}
+
+// Сообщение с числом: по case на каждое значение против одного default
+// с шаблоном print("... {I}")
+static void benchTemplates(int caseCount, int evaluations) {
+    ostringstream perValue;
+    perValue << "switch (I) {\n";
+    for (int i = 0; i < caseCount; i++) {
+        perValue << "    case " << i << ":\n        print(\"Значение " << i << " принято\");\n        break;\n";
+    }
+    perValue << "    default:\n        print(\"Значение вне диапазона\");\n}\n";
+    string templated = "switch (I) {\n    default:\n        print(\"Значение {I} принято\");\n}\n";
+    
+    auto measure = [&](const string& source, const char* name) {
+        vector<SwitchDiagnostic> diagnostics;
+        unique_ptr<SwitchProgram> program;
+        double compileMs = measureMs([&] {
+            program = SwitchProgram::compile(source.data(), source.size(), diagnostics);
+        });
+        const CompiledProgram& compiled = program->compiled();
+        char buffer[256];
+        size_t total = 0;
+        double evaluateMs = measureMs([&] {
+            for (int i = 0; i < evaluations; i++) {
+                total += program->evaluate(i % caseCount, buffer, sizeof(buffer));
+            }
+        });
+        cout << "  " << name << ": компиляция " << compileMs << " мс, действий "
+             << compiled.actions.size() << ", строк " << compiled.outputData.size() / 1024
+             << " КБ, вычисление " << evaluateMs * 1e6 / evaluations << " нс (вывод " << total << " байт)" << endl;
+    };
+    
+    cout << "Шаблоны print (" << caseCount << " значений):" << endl;
+    measure(perValue.str(), "case на значение");
+    measure(templated, "шаблон в default");
+}
+
+// Цена интервала трассировки: выключенной и включенной
+static void benchTrace(int spans) {
+    auto perSpan = [&] {
+        double ms = measureMs([&] {
+            for (int i = 0; i < spans; i++) {
+                TRACE_SCOPE("bench");
+            }
+        });
+        return ms * 1e6 / spans;
+    };
+    
+    double disabled = perSpan();
+    Trace::enable();
+    double enabled = perSpan();
+    cout << "Трассировка: выключена " << disabled << " нс/интервал, включена "
+         << enabled << " нс/интервал" << endl;
+}
+
+int main() {
+    benchTraversal(10000, 4, 200);
+    benchTraversal(100000, 2, 20);
+    benchDispatch();
+    benchProfile();
+    benchAnalysis(1000000);
+    benchDuplicateCheck(200000);
+    benchLibrary(1000, 1000000, 4);
+    benchImage(100000, 1);
+    benchImage(100000, 3);
+    benchLazy(1000000, 2);
+    benchRecovery(200000, 0);
+    benchRecovery(200000, 100);
+    benchBatch(20000);
+    benchFallthrough(10000, 8);
+    benchTemplates(10000, 1000000);
+    benchTrace(1000000);
+    benchLatency(1000, 1000000);
+    benchRegressions("regressions");
+    return 0;
+}
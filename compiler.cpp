@@ -0,0 +1,365 @@
+#include "compiler.h"
+#include <algorithm>
+
+using namespace std;
+
+// Добавление значения к ключу слияния (побайтовое представление)
+template <typename T>
+static void appendKey(string& key, T value) {
+    key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static bool isNameStart(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static bool isNameChar(char c) {
+    return isNameStart(c) || (c >= '0' && c <= '9');
+}
+
+// Имя переменной в {ИМЯ}, начинающемся с text[open]; пусто, если
+// после '{' не идут имя и '}' или имя не из variables
+static string_view templateName(string_view text, size_t open, const vector<string_view>& variables) {
+    size_t end = open + 1;
+    if (end >= text.size() || !isNameStart(text[end])) return {};
+    while (end < text.size() && isNameChar(text[end])) end++;
+    if (end >= text.size() || text[end] != '}') return {};
+    string_view name = text.substr(open + 1, end - open - 1);
+    return find(variables.begin(), variables.end(), name) != variables.end() ? name : string_view();
+}
+
+bool splitTemplate(string_view text, const vector<string_view>& variables, vector<TemplatePart>& parts) {
+    parts.clear();
+    bool hasVariables = false;
+    string literal;
+    for (size_t i = 0; i < text.size(); i++) {
+        char c = text[i];
+        if (c == '{') {
+            // {{ИМЯ}} — текст {ИМЯ} без подстановки
+            string_view escaped = i + 1 < text.size() && text[i + 1] == '{'
+                ? templateName(text, i + 1, variables) : string_view();
+            size_t escapedEnd = i + escaped.size() + 3;
+            if (!escaped.empty() && escapedEnd < text.size() && text[escapedEnd] == '}') {
+                literal += text.substr(i + 1, escaped.size() + 2);
+                i = escapedEnd;
+                continue;
+            }
+            string_view name = templateName(text, i, variables);
+            if (!name.empty()) {
+                if (!literal.empty()) parts.push_back({false, move(literal)});
+                literal.clear();
+                parts.push_back({true, string(name)});
+                hasVariables = true;
+                i += name.size() + 1;
+                continue;
+            }
+        }
+        literal += c;
+    }
+    if (!literal.empty()) parts.push_back({false, move(literal)});
+    return hasVariables;
+}
+
+size_t templateLength(const vector<TemplatePart>& parts) {
+    // Самое длинное значение int32_t — "-2147483648"
+    const size_t numberLength = 11;
+    size_t length = 0;
+    for (const TemplatePart& part : parts) {
+        length += part.isVariable ? numberLength : part.text.size();
+    }
+    return length;
+}
+
+int CompiledProgram::variableIndex(const string& name) const {
+    for (size_t i = 0; i < variables.size(); i++) {
+        if (variables[i] == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+void CompiledProgram::enableProfiling() {
+    for (CompiledSwitch& node : switches) {
+        size_t slots = node.caseBodies.size() + 1;
+        node.hitCounters = make_unique<atomic<uint64_t>[]>(slots);
+        for (size_t i = 0; i < slots; i++) {
+            node.hitCounters[i].store(0, memory_order_relaxed);
+        }
+    }
+}
+
+void CompiledProgram::exportProfile(CaseProfile& profile) const {
+    for (size_t index = 0; index < switches.size(); index++) {
+        const CompiledSwitch& node = switches[index];
+        if (!node.hitCounters) continue;
+        const string& path = switchPaths[index];
+        for (uint32_t i = 0; i < node.caseBodies.size(); i++) {
+            profile.addCaseHits(path, node.dispatcher.key(i),
+                                node.hitCounters[i].load(memory_order_relaxed));
+        }
+        profile.addDefaultHits(path,
+            node.hitCounters[node.caseBodies.size()].load(memory_order_relaxed));
+    }
+}
+
+CompiledProgram Compiler::compile(const ASTNode& ast, const CaseProfile* caseProfile,
+                                  const vector<string>& variables, bool recordProfile) {
+    program = CompiledProgram();
+    profile = caseProfile;
+    profiling = recordProfile;
+    variableIds.clear();
+    outputIds.clear();
+    runIds.clear();
+    bodyIds.clear();
+    switchIds.clear();
+    templateIds.clear();
+    enclosingVariables.clear();
+    for (const string& name : variables) {
+        internVariable(name);
+    }
+    
+    visitNode(ast, [this](const SwitchNode& node) {
+        // Размер таблиц слияния известен заранее хотя бы для внешнего switch
+        size_t expected = node.cases.size() + 1;
+        outputIds.reserve(expected);
+        runIds.reserve(expected);
+        bodyIds.reserve(expected);
+        program.bodies.reserve(expected);
+        program.actions.reserve(expected);
+        program.root = compileSwitchNode(node, node.variable.lexeme);
+    });
+    return move(program);
+}
+
+uint32_t Compiler::compileSwitchNode(const SwitchNode& node, const string& path) {
+    program.sourceSwitchCount++;
+    uint32_t variable = internVariable(node.variable.lexeme);
+    
+    // Метки case и default в исходном порядке. Тела до ближайшего break
+    // составляют один отрезок; последний отрезок продолжается в default.
+    struct Label {
+        int32_t key;
+        bool isDefault;
+        uint64_t hits;
+        size_t run;   // номер отрезка
+        size_t part;  // номер тела метки внутри отрезка
+    };
+    struct Run {
+        vector<RunPart> parts;
+        uint64_t hits = 0;
+    };
+    vector<Label> labels;
+    labels.reserve(node.cases.size() + 1);
+    vector<Run> runs(1);
+    
+    auto addLabel = [&](const ActionList& actions, int32_t key, bool isDefault, uint64_t hits) {
+        Run& run = runs.back();
+        labels.push_back({key, isDefault, hits, runs.size() - 1, run.parts.size()});
+        run.parts.push_back({&actions, path + "/" + (isDefault ? string("default") : to_string(key))});
+        run.hits += hits;
+    };
+    
+    for (auto& caseNodePtr : node.cases) {
+        visitNode(*caseNodePtr, [&](const CaseNode& caseNode) {
+            uint64_t hits = profile ? profile->caseHits(path, caseNode.key) : 0;
+            addLabel(caseNode.actions, caseNode.key, false, hits);
+            if (caseNode.hasBreak) runs.emplace_back();
+        });
+    }
+    
+    if (node.defaultCase) {
+        visitNode(*node.defaultCase, [&](const DefaultNode& defaultNode) {
+            addLabel(defaultNode.actions, 0, true, profile ? profile->defaultHits(path) : 0);
+        });
+    }
+    if (runs.back().parts.empty()) runs.pop_back();
+    
+    // По профилю: горячие отрезки вперед, и их строки окажутся рядом
+    // в outputData; ключи упорядочиваются по попаданиям отдельно
+    vector<size_t> layout(runs.size());
+    for (size_t i = 0; i < layout.size(); i++) layout[i] = i;
+    if (profile) {
+        stable_sort(layout.begin(), layout.end(), [&](size_t a, size_t b) {
+            return runs[a].hits > runs[b].hits;
+        });
+        stable_sort(labels.begin(), labels.end(), [](const Label& a, const Label& b) {
+            return a.hits > b.hits;
+        });
+    }
+    
+    vector<uint32_t> runStarts(runs.size());
+    vector<uint32_t> runEnds(runs.size());
+    vector<vector<uint32_t>> partOffsets(runs.size());
+    enclosingVariables.push_back(node.variable.lexeme);
+    for (size_t run : layout) {
+        runStarts[run] = compileRun(runs[run].parts, partOffsets[run]);
+        runEnds[run] = runStarts[run] + partOffsets[run].back();
+    }
+    enclosingVariables.pop_back();
+    
+    CompiledSwitch compiled;
+    compiled.variable = variable;
+    vector<int32_t> keys;
+    keys.reserve(labels.size());
+    uint64_t totalCaseHits = 0;
+    for (const Label& label : labels) {
+        uint32_t first = runStarts[label.run] + partOffsets[label.run][label.part];
+        uint32_t body = internBody(first, runEnds[label.run] - first);
+        if (label.isDefault) {
+            compiled.defaultBody = body;
+        } else {
+            keys.push_back(label.key);
+            compiled.caseBodies.push_back(body);
+            totalCaseHits += label.hits;
+        }
+    }
+    
+    // Одинаковые switch (та же переменная, ключи и тела) хранятся один раз,
+    // если попадания в них не нужно считать раздельно
+    string mergeKey;
+    if (!profiling) {
+        appendKey(mergeKey, variable);
+        appendKey(mergeKey, compiled.defaultBody);
+        for (size_t i = 0; i < keys.size(); i++) {
+            appendKey(mergeKey, keys[i]);
+            appendKey(mergeKey, compiled.caseBodies[i]);
+        }
+        auto existing = switchIds.find(mergeKey);
+        if (existing != switchIds.end()) {
+            return existing->second;
+        }
+    }
+    
+    compiled.dispatcher.build(keys);
+    
+    // Префикс горячих ключей, покрывающий заданную долю попаданий
+    if (profile && totalCaseHits > 0) {
+        uint64_t covered = 0;
+        size_t hotCount = 0;
+        for (const Label& label : labels) {
+            if (label.isDefault) continue;
+            if (covered >= totalCaseHits * HOT_PREFIX_COVERAGE ||
+                hotCount >= CaseDispatcher::HOT_PREFIX_MAX) break;
+            covered += label.hits;
+            hotCount++;
+        }
+        compiled.dispatcher.setHotPrefix(hotCount);
+    }
+    
+    uint32_t index = static_cast<uint32_t>(program.switches.size());
+    program.switches.push_back(move(compiled));
+    program.switchPaths.push_back(path);
+    if (!profiling) switchIds.emplace(move(mergeKey), index);
+    return index;
+}
+
+uint32_t Compiler::compileRun(const vector<RunPart>& parts, vector<uint32_t>& offsets) {
+    vector<CompiledAction> compiled;
+    offsets.clear();
+    for (const RunPart& part : parts) {
+        offsets.push_back(static_cast<uint32_t>(compiled.size()));
+        // Номер switch по той же переменной в теле метки для пути "#2"
+        unordered_map<string, uint32_t> switchNumbers;
+        for (auto& action : *part.actions) {
+            visitNode(*action, Overloaded{
+                [&](const PrintNode& printNode) {
+                    compiled.push_back(compilePrint(printNode.text.lexeme));
+                },
+                [&](const SwitchNode& switchNode) {
+                    const string& name = switchNode.variable.lexeme;
+                    uint32_t number = ++switchNumbers[name];
+                    string path = part.labelPath + "/" + name;
+                    if (number > 1) path += "#" + to_string(number);
+                    compiled.push_back({CompiledAction::SWITCH, compileSwitchNode(switchNode, path)});
+                }
+            });
+        }
+    }
+    offsets.push_back(static_cast<uint32_t>(compiled.size()));
+    
+    // Одинаковые отрезки хранятся один раз
+    string mergeKey;
+    for (const CompiledAction& action : compiled) {
+        appendKey(mergeKey, action.kind);
+        appendKey(mergeKey, action.index);
+    }
+    auto existing = runIds.find(mergeKey);
+    if (existing != runIds.end()) {
+        return existing->second;
+    }
+    
+    uint32_t first = static_cast<uint32_t>(program.actions.size());
+    program.actions.insert(program.actions.end(), compiled.begin(), compiled.end());
+    runIds.emplace(move(mergeKey), first);
+    return first;
+}
+
+uint32_t Compiler::internBody(uint32_t firstAction, uint32_t actionCount) {
+    uint64_t key = uint64_t(firstAction) << 32 | actionCount;
+    auto it = bodyIds.find(key);
+    if (it != bodyIds.end()) return it->second;
+    
+    uint32_t index = static_cast<uint32_t>(program.bodies.size());
+    program.bodies.push_back(CompiledBody{firstAction, actionCount});
+    bodyIds.emplace(key, index);
+    return index;
+}
+
+uint32_t Compiler::internVariable(const string& name) {
+    auto it = variableIds.find(name);
+    if (it != variableIds.end()) return it->second;
+    
+    uint32_t index = static_cast<uint32_t>(program.variables.size());
+    program.variables.push_back(name);
+    variableIds.emplace(name, index);
+    return index;
+}
+
+uint32_t Compiler::internOutput(const string& text) {
+    auto it = outputIds.find(text);
+    if (it != outputIds.end()) return it->second;
+    
+    uint32_t index = static_cast<uint32_t>(program.outputOffsets.size() - 1);
+    program.outputData += text;
+    program.outputOffsets.push_back(static_cast<uint32_t>(program.outputData.size()));
+    outputIds.emplace(text, index);
+    return index;
+}
+
+CompiledAction Compiler::compilePrint(const string& text) {
+    // Обычный текст без фигурных скобок выводится как есть
+    if (text.find('{') == string::npos) {
+        return {CompiledAction::OUTPUT, internOutput(text)};
+    }
+    
+    // Разбор зависит от переменных объемлющих switch, они входят в ключ
+    string key = text;
+    for (string_view name : enclosingVariables) {
+        key += '\0';
+        key += name;
+    }
+    auto it = templateIds.find(key);
+    if (it != templateIds.end()) return {CompiledAction::TEMPLATE, it->second};
+    
+    vector<TemplatePart> parts;
+    if (!splitTemplate(text, enclosingVariables, parts)) {
+        return {CompiledAction::OUTPUT, internOutput(parts.empty() ? string() : parts[0].text)};
+    }
+    
+    // Сегменты готовы к подстановке: литералы в общем блоке строк,
+    // имена заменены индексами переменных
+    CompiledTemplate compiled;
+    compiled.firstSegment = static_cast<uint32_t>(program.segments.size());
+    compiled.segmentCount = static_cast<uint32_t>(parts.size());
+    for (const TemplatePart& part : parts) {
+        if (part.isVariable) {
+            program.segments.push_back({CompiledSegment::VARIABLE, internVariable(part.text)});
+        } else {
+            program.segments.push_back({CompiledSegment::LITERAL, internOutput(part.text)});
+        }
+    }
+    
+    uint32_t index = static_cast<uint32_t>(program.templates.size());
+    program.templates.push_back(compiled);
+    templateIds.emplace(move(key), index);
+    return {CompiledAction::TEMPLATE, index};
+}
@@ -0,0 +1,265 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "parser.h"
+#include "dispatch.h"
+#include "profile.h"
+#include "latency.h"
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Действие тела: вывод строки или шаблона либо переход во вложенный switch
+struct CompiledAction {
+    enum Kind : uint32_t {
+        OUTPUT,
+        SWITCH,
+        TEMPLATE
+    };
+    
+    Kind kind;
+    uint32_t index; // индекс строки, узла switch или шаблона
+};
+
+// Сегмент шаблона print("значение {I}"): литерал или значение переменной
+struct CompiledSegment {
+    enum Kind : uint32_t {
+        LITERAL,
+        VARIABLE
+    };
+    
+    Kind kind;
+    uint32_t index; // индекс строки или переменной
+};
+
+// Шаблон: непрерывный отрезок таблицы сегментов
+struct CompiledTemplate {
+    // Наибольшая длина строки после подстановки (литералы и по 11 символов
+    // на число); больше анализатор не допускает
+    static constexpr size_t MAX_LENGTH = 1024;
+    
+    uint32_t firstSegment = 0;
+    uint32_t segmentCount = 0;
+};
+
+// Часть текста print: литерал или имя переменной из {ИМЯ}
+struct TemplatePart {
+    bool isVariable;
+    std::string text;
+};
+
+// Разбор текста print на части. Подстановка — только {ИМЯ} с именем
+// переменной объемлющего switch из variables, а {{ИМЯ}} с таким именем
+// выводится как {ИМЯ}. Другие имена и фигурные скобки выводятся как есть,
+// поэтому print, написанные до появления шаблонов, не меняют вывод.
+// false — в тексте нет подстановок.
+bool splitTemplate(std::string_view text, const std::vector<std::string_view>& variables,
+                   std::vector<TemplatePart>& parts);
+
+// Наибольшая длина строки после подстановки
+size_t templateLength(const std::vector<TemplatePart>& parts);
+
+// Подстановка значений: литералы копируются, числа форматируются
+// std::to_chars в буфер на стеке, и emit(string_view) получает готовую
+// строку без выделения памяти. Не встраивается, чтобы буфер не увеличивал
+// кадр рекурсивного вычисления switch.
+template <typename OutputText, typename Emit>
+__attribute__((noinline))
+void renderTemplate(const CompiledSegment* segments, uint32_t count, const int32_t* values,
+                    OutputText&& outputText, Emit&& emit) {
+    char buffer[CompiledTemplate::MAX_LENGTH];
+    char* end = buffer;
+    for (uint32_t i = 0; i < count; i++) {
+        if (segments[i].kind == CompiledSegment::LITERAL) {
+            std::string_view text = outputText(segments[i].index);
+            memcpy(end, text.data(), text.size());
+            end += text.size();
+        } else {
+            end = std::to_chars(end, buffer + sizeof(buffer), values[segments[i].index]).ptr;
+        }
+    }
+    emit(std::string_view(buffer, static_cast<size_t>(end - buffer)));
+}
+
+// Тело case или default: непрерывный отрезок таблицы действий. Тела,
+// выполняемые подряд (case без break), размещаются одним отрезком,
+// и тело каждой метки — его суффикс: проваливание — это просто
+// продолжение отрезка, а метки группы указывают на одну копию действий.
+struct CompiledBody {
+    uint32_t firstAction = 0;
+    uint32_t actionCount = 0;
+};
+
+// Узел решающего DAG: выбор тела по значению одной переменной
+struct CompiledSwitch {
+    static constexpr uint32_t NO_BODY = UINT32_MAX;
+    
+    uint32_t variable = 0;             // индекс в CompiledProgram::variables
+    CaseDispatcher dispatcher;         // значение case -> индекс ключа
+    std::vector<uint32_t> caseBodies;  // индекс тела по индексу ключа
+    uint32_t defaultBody = NO_BODY;
+    
+    // Счетчики попаданий: по одному на case и последний для default.
+    // Пусто, если профилирование не включено.
+    std::unique_ptr<std::atomic<uint64_t>[]> hitCounters;
+    
+    // Учет попадания: index — индекс ключа или CaseDispatcher::NOT_FOUND
+    void recordHit(uint32_t index) const {
+        if (!hitCounters) return;
+        uint32_t slot = index == CaseDispatcher::NOT_FOUND
+            ? static_cast<uint32_t>(caseBodies.size()) : index;
+        hitCounters[slot].fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+// Скомпилированная программа: вложенные switch сведены в DAG, одинаковые
+// тела и switch хранятся в одном экземпляре. Набор значений переменных
+// вычисляется за один проход от корня.
+struct CompiledProgram {
+    std::vector<std::string> variables;    // имена в порядке появления
+    std::vector<CompiledSwitch> switches;
+    std::vector<CompiledBody> bodies;
+    std::vector<CompiledAction> actions;
+    std::vector<CompiledTemplate> templates;
+    std::vector<CompiledSegment> segments;
+    uint32_t root = 0;                     // корневой switch
+    size_t sourceSwitchCount = 0;          // switch в исходном тексте
+    
+    // Путь в исходном тексте (ключ профиля, см. CaseProfile) по индексу
+    // switch; у слитых switch — путь первого из них
+    std::vector<std::string> switchPaths;
+    
+    // Тексты всех print одним блоком; строка i занимает
+    // [outputOffsets[i], outputOffsets[i + 1])
+    std::string outputData;
+    std::vector<uint32_t> outputOffsets{0};
+    
+    std::string_view output(uint32_t index) const {
+        return std::string_view(outputData).substr(outputOffsets[index],
+            outputOffsets[index + 1] - outputOffsets[index]);
+    }
+    
+    // Строка шаблона для набора значений переменных
+    template <typename Emit>
+    void render(uint32_t index, const int32_t* values, Emit&& emit) const {
+        const CompiledTemplate& compiled = templates[index];
+        renderTemplate(segments.data() + compiled.firstSegment, compiled.segmentCount, values,
+                       [this](uint32_t text) { return output(text); }, emit);
+    }
+    
+    // Индекс переменной по имени или -1
+    int variableIndex(const std::string& name) const;
+    
+    // Вычисление для набора значений (values[i] — значение variables[i]).
+    // Sink получает события onCase, onDefault, onNoMatch и onOutput.
+    // Если задан sample, в него накапливается время поиска case и вывода;
+    // измерять ли вычисление, решает вызывающий (Latency::measure).
+    template <typename Sink>
+    void evaluate(const int32_t* values, Sink& sink, LatencySample* sample = nullptr) const {
+        if (switches.empty()) return;
+        if (sample) {
+            evaluateSwitch<true>(root, values, sink, 0, sample);
+        } else {
+            evaluateSwitch<false>(root, values, sink, 0, nullptr);
+        }
+    }
+    
+    void enableProfiling();
+    void exportProfile(CaseProfile& profile) const;
+
+private:
+    template <bool TIMED, typename Sink>
+    void evaluateSwitch(uint32_t index, const int32_t* values, Sink& sink, int depth,
+                        LatencySample* sample) const {
+        const CompiledSwitch& node = switches[index];
+        enterPhase<TIMED>(sample, LatencyKind::LOOKUP);
+        uint32_t keyIndex = node.dispatcher.find(values[node.variable]);
+        node.recordHit(keyIndex);
+        
+        enterPhase<TIMED>(sample, LatencyKind::EMIT);
+        uint32_t bodyIndex;
+        if (keyIndex != CaseDispatcher::NOT_FOUND) {
+            sink.onCase(*this, node, keyIndex, depth);
+            bodyIndex = node.caseBodies[keyIndex];
+        } else if (node.defaultBody != CompiledSwitch::NO_BODY) {
+            sink.onDefault(*this, node, depth);
+            bodyIndex = node.defaultBody;
+        } else {
+            sink.onNoMatch(*this, node, depth);
+            return;
+        }
+        
+        const CompiledBody& body = bodies[bodyIndex];
+        for (uint32_t i = 0; i < body.actionCount; i++) {
+            const CompiledAction& action = actions[body.firstAction + i];
+            if (action.kind == CompiledAction::OUTPUT) {
+                enterPhase<TIMED>(sample, LatencyKind::EMIT);
+                sink.onOutput(output(action.index), depth);
+            } else if (action.kind == CompiledAction::TEMPLATE) {
+                enterPhase<TIMED>(sample, LatencyKind::EMIT);
+                render(action.index, values, [&](std::string_view text) { sink.onOutput(text, depth); });
+            } else {
+                evaluateSwitch<TIMED>(action.index, values, sink, depth + 1, sample);
+            }
+        }
+    }
+};
+
+class Compiler {
+public:
+    // profile (если задан) определяет порядок ключей и раскладку строк:
+    // горячие case проверяются первыми, их тексты лежат рядом.
+    // variables занимают первые номера переменных, даже если их switch
+    // нет в ast (отложенный разбор строит только часть программы).
+    // recordProfile — программа будет записывать профиль: одинаковые switch
+    // не сливаются, чтобы у каждого switch исходного текста были свои
+    // счетчики.
+    CompiledProgram compile(const ASTNode& ast, const CaseProfile* profile = nullptr,
+                            const std::vector<std::string>& variables = {},
+                            bool recordProfile = false);
+    
+    // Доля попаданий, которую должен покрывать префикс горячих ключей
+    static constexpr double HOT_PREFIX_COVERAGE = 0.9;
+
+private:
+    CompiledProgram program;
+    const CaseProfile* profile = nullptr;
+    bool profiling = false;
+    
+    // Таблицы для слияния одинаковых строк, отрезков действий, тел и switch
+    std::unordered_map<std::string, uint32_t> variableIds;
+    std::unordered_map<std::string, uint32_t> outputIds;
+    std::unordered_map<std::string, uint32_t> runIds;
+    std::unordered_map<uint64_t, uint32_t> bodyIds;
+    std::unordered_map<std::string, uint32_t> switchIds;
+    std::unordered_map<std::string, uint32_t> templateIds;
+    
+    // Переменные объемлющих switch: от них зависит разбор шаблонов
+    std::vector<std::string_view> enclosingVariables;
+    
+    using ActionList = std::vector<std::unique_ptr<ASTNode>>;
+    
+    // Тело метки и путь к ней ("I/5") для вложенных в тело switch
+    struct RunPart {
+        const ActionList* actions;
+        std::string labelPath;
+    };
+    
+    // path — путь к switch в исходном тексте
+    uint32_t compileSwitchNode(const SwitchNode& node, const std::string& path);
+    // Тела, выполняемые подряд, одним отрезком; offsets[i] — начало
+    // i-го тела от начала отрезка. Возвращает начало отрезка в actions.
+    uint32_t compileRun(const std::vector<RunPart>& parts, std::vector<uint32_t>& offsets);
+    uint32_t internBody(uint32_t firstAction, uint32_t actionCount);
+    uint32_t internVariable(const std::string& name);
+    uint32_t internOutput(const std::string& text);
+    CompiledAction compilePrint(const std::string& text);
+};
+
+#endif // COMPILER_H
@@ -0,0 +1,209 @@
+#include "dispatch.h"
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DISPATCH_X86 1
+#endif
+
+using namespace std;
+
+uint32_t findKeyScalar(const KeyBlock* blocks, size_t count, int32_t value) {
+    for (size_t i = 0; i < count; i++) {
+        if (blocks[i / 8].lanes[i % 8] == value) {
+            return static_cast<uint32_t>(i);
+        }
+    }
+    return CaseDispatcher::NOT_FOUND;
+}
+
+#ifdef DISPATCH_X86
+
+// SSE2: 4 ключа за сравнение, по два сравнения на блок
+static uint32_t findKeySSE2(const KeyBlock* blocks, size_t count, int32_t value) {
+    const __m128i probe = _mm_set1_epi32(value);
+    size_t blockCount = (count + 7) / 8;
+    for (size_t b = 0; b < blockCount; b++) {
+        const __m128i* lanes = reinterpret_cast<const __m128i*>(blocks[b].lanes);
+        __m128i low = _mm_cmpeq_epi32(_mm_load_si128(lanes), probe);
+        __m128i high = _mm_cmpeq_epi32(_mm_load_si128(lanes + 1), probe);
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(low)) |
+                   (_mm_movemask_ps(_mm_castsi128_ps(high)) << 4);
+        if (mask) {
+            return static_cast<uint32_t>(b * 8 + __builtin_ctz(mask));
+        }
+    }
+    return CaseDispatcher::NOT_FOUND;
+}
+
+// AVX2: 8 ключей за сравнение, по два блока (16 ключей) за итерацию
+__attribute__((target("avx2")))
+static uint32_t findKeyAVX2(const KeyBlock* blocks, size_t count, int32_t value) {
+    const __m256i probe = _mm256_set1_epi32(value);
+    size_t blockCount = (count + 7) / 8;
+    size_t b = 0;
+    for (; b + 1 < blockCount; b += 2) {
+        __m256i first = _mm256_cmpeq_epi32(
+            _mm256_load_si256(reinterpret_cast<const __m256i*>(blocks[b].lanes)), probe);
+        __m256i second = _mm256_cmpeq_epi32(
+            _mm256_load_si256(reinterpret_cast<const __m256i*>(blocks[b + 1].lanes)), probe);
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(first))) |
+                        (static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(second))) << 8);
+        if (mask) {
+            return static_cast<uint32_t>(b * 8 + __builtin_ctz(mask));
+        }
+    }
+    if (b < blockCount) {
+        __m256i last = _mm256_cmpeq_epi32(
+            _mm256_load_si256(reinterpret_cast<const __m256i*>(blocks[b].lanes)), probe);
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(last));
+        if (mask) {
+            return static_cast<uint32_t>(b * 8 + __builtin_ctz(mask));
+        }
+    }
+    return CaseDispatcher::NOT_FOUND;
+}
+
+#endif // DISPATCH_X86
+
+// Проверка одного блока без косвенного вызова ядра (для горячего префикса)
+static inline uint32_t matchBlock(const KeyBlock& block, int32_t value) {
+#ifdef DISPATCH_X86
+    const __m128i probe = _mm_set1_epi32(value);
+    const __m128i* lanes = reinterpret_cast<const __m128i*>(block.lanes);
+    __m128i low = _mm_cmpeq_epi32(_mm_load_si128(lanes), probe);
+    __m128i high = _mm_cmpeq_epi32(_mm_load_si128(lanes + 1), probe);
+    int mask = _mm_movemask_ps(_mm_castsi128_ps(low)) |
+               (_mm_movemask_ps(_mm_castsi128_ps(high)) << 4);
+    return mask ? static_cast<uint32_t>(__builtin_ctz(mask)) : CaseDispatcher::NOT_FOUND;
+#else
+    for (uint32_t i = 0; i < 8; i++) {
+        if (block.lanes[i] == value) return i;
+    }
+    return CaseDispatcher::NOT_FOUND;
+#endif
+}
+
+uint32_t findKeyInBlock(const KeyBlock& block, int32_t value) {
+    return matchBlock(block, value);
+}
+
+using FindKeyFunction = uint32_t (*)(const KeyBlock*, size_t, int32_t);
+
+struct VectorKernel {
+    FindKeyFunction function;
+    const char* name;
+};
+
+// Ядро выбирается один раз при первом обращении
+static const VectorKernel& selectKernel() {
+    static const VectorKernel kernel = [] {
+#ifdef DISPATCH_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return VectorKernel{findKeyAVX2, "AVX2"};
+        }
+        return VectorKernel{findKeySSE2, "SSE2"};
+#else
+        return VectorKernel{findKeyScalar, "скалярное"};
+#endif
+    }();
+    return kernel;
+}
+
+uint32_t findKeyVector(const KeyBlock* blocks, size_t count, int32_t value) {
+    return selectKernel().function(blocks, count, value);
+}
+
+const char* vectorKernelName() {
+    return selectKernel().name;
+}
+
+DispatchKind CaseDispatcher::chooseKind(const vector<int32_t>& keys) {
+    if (keys.size() <= LINEAR_DENSE_THRESHOLD) {
+        return DispatchKind::LINEAR;
+    }
+    
+    int64_t minValue = keys[0];
+    int64_t maxValue = keys[0];
+    for (int32_t key : keys) {
+        if (key < minValue) minValue = key;
+        if (key > maxValue) maxValue = key;
+    }
+    
+    // Таблица переходов оправдана, если заполнена хотя бы наполовину
+    if (maxValue - minValue + 1 <= static_cast<int64_t>(keys.size()) * 2) {
+        return DispatchKind::JUMP_TABLE;
+    }
+    return keys.size() <= LINEAR_THRESHOLD ? DispatchKind::LINEAR : DispatchKind::HASH;
+}
+
+void CaseDispatcher::build(const vector<int32_t>& keys) {
+    build(keys, chooseKind(keys));
+}
+
+void CaseDispatcher::build(const vector<int32_t>& keys, DispatchKind kind) {
+    dispatch = kind;
+    count = keys.size();
+    hotCount = 0;
+    jumpTable.clear();
+    hashTable.clear();
+    
+    blocks.assign((count + 7) / 8, KeyBlock{});
+    for (size_t i = 0; i < blocks.size() * 8; i++) {
+        blocks[i / 8].lanes[i % 8] = i < count ? keys[i] : keys[0];
+    }
+    
+    if (count == 0) {
+        dispatch = DispatchKind::LINEAR;
+        return;
+    }
+    
+    if (dispatch == DispatchKind::JUMP_TABLE) {
+        int64_t minValue = keys[0];
+        int64_t maxValue = keys[0];
+        for (int32_t key : keys) {
+            if (key < minValue) minValue = key;
+            if (key > maxValue) maxValue = key;
+        }
+        minKey = static_cast<int32_t>(minValue);
+        jumpTable.assign(static_cast<size_t>(maxValue - minValue + 1), NOT_FOUND);
+        for (size_t i = 0; i < count; i++) {
+            uint32_t& slot = jumpTable[static_cast<size_t>(static_cast<int64_t>(keys[i]) - minKey)];
+            if (slot == NOT_FOUND) slot = static_cast<uint32_t>(i);
+        }
+    } else if (dispatch == DispatchKind::HASH) {
+        hashTable.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            hashTable.emplace(keys[i], static_cast<uint32_t>(i));
+        }
+    }
+}
+
+void CaseDispatcher::setHotPrefix(size_t hot) {
+    // При линейном переборе горячие ключи и так проверяются первыми
+    hotCount = dispatch == DispatchKind::LINEAR ? 0 : min(min(hot, count), HOT_PREFIX_MAX);
+}
+
+uint32_t CaseDispatcher::find(int32_t value) const {
+    if (hotCount) {
+        // Совпадение за пределами префикса в том же блоке — тоже настоящий
+        // ключ, поэтому найденный индекс корректен
+        uint32_t index = matchBlock(blocks[0], value);
+        if (index != NOT_FOUND) return index;
+    }
+    
+    switch (dispatch) {
+        case DispatchKind::LINEAR:
+            return count == 0 ? NOT_FOUND : findKeyVector(blocks.data(), count, value);
+        case DispatchKind::JUMP_TABLE: {
+            uint64_t offset = static_cast<uint64_t>(static_cast<int64_t>(value) - minKey);
+            return offset < jumpTable.size() ? jumpTable[offset] : NOT_FOUND;
+        }
+        case DispatchKind::HASH: {
+            auto it = hashTable.find(value);
+            return it != hashTable.end() ? it->second : NOT_FOUND;
+        }
+    }
+    return NOT_FOUND;
+}
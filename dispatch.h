@@ -0,0 +1,82 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <unordered_map>
+
+// Стратегия выбора case по значению переменной
+enum class DispatchKind {
+    LINEAR,     // векторный перебор ключей (SIMD)
+    JUMP_TABLE, // таблица переходов для плотного диапазона ключей
+    HASH        // хеш-таблица
+};
+
+// Блок ключей, выровненный под один регистр AVX2
+struct alignas(32) KeyBlock {
+    int32_t lanes[8];
+};
+
+// Поиск первого i < count, для которого keys[i] == value; иначе UINT32_MAX.
+// Хвост последнего блока заполнен копией keys[0], поэтому совпадение
+// в хвосте всегда перекрывается более ранним.
+uint32_t findKeyScalar(const KeyBlock* blocks, size_t count, int32_t value);
+uint32_t findKeyVector(const KeyBlock* blocks, size_t count, int32_t value);
+
+// Поиск в одном блоке (для горячего префикса и образа программы)
+uint32_t findKeyInBlock(const KeyBlock& block, int32_t value);
+
+// Название векторного ядра, выбранного для текущего процессора
+const char* vectorKernelName();
+
+// Хеш ключа для HASH: std::hash<int32_t> — тождественное отображение,
+// и ключи, кратные числу корзин, попадают в одну корзину. Умножение
+// на нечетную 64-битную константу со старшими битами перемешивает их.
+struct KeyHash {
+    size_t operator()(int32_t key) const {
+        uint64_t mixed = static_cast<uint64_t>(static_cast<uint32_t>(key)) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(mixed ^ (mixed >> 32));
+    }
+};
+
+// Таблица выбора case: хранит ключи и находит индекс ключа по значению
+class CaseDispatcher {
+public:
+    static constexpr uint32_t NOT_FOUND = UINT32_MAX;
+    
+    // До этого числа ключей векторный перебор быстрее хеша, а для плотных
+    // ключей — быстрее таблицы переходов (подобрано по make bench, AVX2)
+    static constexpr size_t LINEAR_THRESHOLD = 32;
+    static constexpr size_t LINEAR_DENSE_THRESHOLD = 16;
+    
+    // Выбор стратегии по количеству и плотности ключей
+    static DispatchKind chooseKind(const std::vector<int32_t>& keys);
+    
+    void build(const std::vector<int32_t>& keys);
+    void build(const std::vector<int32_t>& keys, DispatchKind kind);
+    
+    // Первые count ключей (не больше одного блока) проверяются до основной
+    // стратегии. Используется, когда ключи упорядочены по частоте (профиль).
+    static constexpr size_t HOT_PREFIX_MAX = 8;
+    void setHotPrefix(size_t count);
+    
+    uint32_t find(int32_t value) const;
+    
+    DispatchKind kind() const { return dispatch; }
+    size_t size() const { return count; }
+    size_t hotPrefix() const { return hotCount; }
+    int32_t key(uint32_t index) const { return blocks[index / 8].lanes[index % 8]; }
+
+private:
+    DispatchKind dispatch = DispatchKind::LINEAR;
+    std::vector<KeyBlock> blocks;
+    size_t count = 0;
+    size_t hotCount = 0;
+    
+    int32_t minKey = 0;
+    std::vector<uint32_t> jumpTable;
+    std::unordered_map<int32_t, uint32_t, KeyHash> hashTable;
+};
+
+#endif // DISPATCH_H
@@ -9,11 +9,13 @@ ErrorHandler& ErrorHandler::getInstance() {
 }
 
 void ErrorHandler::addError(const string& message, int line, int column) {
+    if (limitReached()) return;
     errors.push_back(Error(message, line, column));
+    if (immediate) printError(errors.back());
 }
 
 void ErrorHandler::addError(const Token& token, const string& message) {
-    errors.push_back(Error(message, token.line, token.column));
+    addError(message, token.line, token.column);
 }
 
 bool ErrorHandler::hasErrors() const {
@@ -26,14 +28,42 @@ void ErrorHandler::printErrors() const {
         return;
     }
     
+    if (immediate) {
+        cout << "Обнаружено ошибок: " << errors.size() << endl;
+        return;
+    }
+    
     cout << "\n=== ОБНАРУЖЕНЫ ОШИБКИ ===\n";
     for (const auto& error : errors) {
-        cout << "[Строка " << error.line << ", Колонка " << error.column 
-             << "]: " << error.message << endl;
+        printError(error);
+    }
+    if (limitReached()) {
+        cout << "Достигнут лимит ошибок (" << maxErrors << "), разбор остановлен\n";
     }
     cout << "=========================\n";
 }
 
+void ErrorHandler::printError(const Error& error) const {
+    cout << "[Строка " << error.line << ", Колонка " << error.column 
+         << "]: " << error.message << endl;
+}
+
 void ErrorHandler::clear() {
     errors.clear();
+}
+
+const vector<Error>& ErrorHandler::getErrors() const {
+    return errors;
+}
+
+void ErrorHandler::setImmediate(bool value) {
+    immediate = value;
+}
+
+void ErrorHandler::setMaxErrors(size_t limit) {
+    maxErrors = limit;
+}
+
+bool ErrorHandler::limitReached() const {
+    return maxErrors != 0 && errors.size() >= maxErrors;
 }
\ No newline at end of file
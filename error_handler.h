@@ -14,8 +14,12 @@ struct Error {
         : message(msg), line(ln), column(col) {}
 };
 
+// Сборщик ошибок. Общий экземпляр getInstance() используется консольной
+// программой; библиотека и потоки создают собственные экземпляры.
 class ErrorHandler {
 public:
+    ErrorHandler() = default;
+    
     static ErrorHandler& getInstance();
     
     void addError(const std::string& message, int line, int column);
@@ -23,12 +27,23 @@ public:
     bool hasErrors() const;
     void printErrors() const;
     void clear();
+    const std::vector<Error>& getErrors() const;
+    
+    // В немедленном режиме ошибка выводится сразу при добавлении,
+    // а printErrors() печатает только итог
+    void setImmediate(bool value);
+    
+    // Лимит числа ошибок (0 — без ограничения). Ошибки сверх лимита
+    // не сохраняются, а разбор по limitReached() прекращается.
+    void setMaxErrors(size_t limit);
+    bool limitReached() const;
     
 private:
-    ErrorHandler() = default;
-    ~ErrorHandler() = default;
+    void printError(const Error& error) const;
     
     std::vector<Error> errors;
+    bool immediate = false;
+    size_t maxErrors = 0;
 };
 
 #endif // ERROR_HANDLER_H
\ No newline at end of file
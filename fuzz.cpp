@@ -0,0 +1,416 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <atomic>
+#include <unordered_set>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "scanner.h"
+#include "parser.h"
+#include "semantic.h"
+#include "lazy.h"
+#include "error_handler.h"
+
+using namespace std;
+
+// Нагрузочный фаззинг front end (make fuzz). Случайные и враждебные входы
+// проходят через Scanner, Parser, SemanticAnalyzer (весь текст и потоковый
+// режим) и отложенный разбор; время и число выделений памяти сравниваются
+// с линейным бюджетом на байт входа. Входы сверх бюджета минимизируются
+// и сохраняются в каталог регрессий, который замеряет make bench.
+// Зависший вход сторож сохраняет перед завершением процесса.
+
+// Подсчет выделений памяти: глобальный operator new только в этой программе
+static atomic<size_t> allocationCount{0};
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    if (void* memory = malloc(size ? size : 1)) return memory;
+    throw bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    free(memory);
+}
+
+// Стоимость прогона одного входа
+struct Cost {
+    double ns;
+    size_t allocations;
+};
+
+static Cost runFrontEnd(const string& input) {
+    size_t allocationsBefore = allocationCount.load(memory_order_relaxed);
+    auto begin = chrono::steady_clock::now();
+    
+    {
+        // Весь текст: восстановление по индексу, полный анализ
+        ErrorHandler errors;
+        Scanner scanner(input);
+        Parser parser(scanner, errors);
+        auto ast = parser.parse();
+        if (!errors.hasErrors()) {
+            SemanticAnalyzer semantic(errors);
+            semantic.setThreadCount(1);
+            semantic.analyze(ast);
+        }
+    }
+    
+    {
+        // Потоковый режим мелкими порциями: восстановление по токенам,
+        // сдвиг буфера, несколько программ подряд
+        size_t offset = 0;
+        Scanner scanner([&](char* buffer, size_t capacity) {
+            size_t size = min(capacity, input.size() - offset);
+            memcpy(buffer, input.data() + offset, size);
+            offset += size;
+            return size;
+        }, 7);
+        while (true) {
+            ErrorHandler errors;
+            Parser parser(scanner, errors);
+            if (parser.isAtEnd()) break;
+            auto ast = parser.parse();
+        }
+    }
+    
+    {
+        // Отложенный разбор: индекс заголовков и выполняемые тела
+        CaseIndex index;
+        if (index.build(input)) {
+            ErrorHandler errors;
+            auto ast = index.parseSelected(1, errors);
+            if (!errors.hasErrors()) {
+                SemanticAnalyzer semantic(errors);
+                semantic.setThreadCount(1);
+                semantic.analyze(ast);
+            }
+        }
+    }
+    
+    auto end = chrono::steady_clock::now();
+    return {chrono::duration<double, nano>(end - begin).count(),
+            allocationCount.load(memory_order_relaxed) - allocationsBefore};
+}
+
+// Линейный бюджет: постоянная часть и наклон, кратный замеренному
+// на корректных программах
+struct Budget {
+    static constexpr double FIXED_NS = 500000;
+    static constexpr double FIXED_ALLOCATIONS = 4096;
+    static constexpr double SLACK = 16;
+    
+    double nsPerByte = 0;
+    double allocationsPerByte = 0;
+    
+    bool exceeded(const Cost& cost, size_t bytes) const {
+        return cost.ns > FIXED_NS + SLACK * nsPerByte * bytes ||
+               cost.allocations > FIXED_ALLOCATIONS + SLACK * allocationsPerByte * bytes;
+    }
+};
+
+class Generator {
+public:
+    explicit Generator(uint64_t seed) : random(seed) {}
+    
+    size_t below(size_t limit) { return limit ? random() % limit : 0; }
+    
+    // Корректная программа: вложенные switch, группы меток, шаблоны
+    string validProgram(size_t targetBytes, int depth = 0) {
+        ostringstream out;
+        out << "switch (" << (depth ? "J" : "I") << ") {\n";
+        int key = 0;
+        while (static_cast<size_t>(out.tellp()) < targetBytes) {
+            key += 1 + static_cast<int>(below(3));
+            out << "    case " << key << ":\n";
+            if (below(4) == 0) continue; // метка группы
+            out << "        print(\"Значение " << key << (below(3) ? "\");\n" : " {I}\");\n");
+            if (depth < 3 && below(16) == 0) {
+                out << validProgram(64 + below(256), depth + 1) << "\n";
+            }
+            if (below(5)) out << "        break;\n";
+        }
+        out << "    default:\n        print(\"Иначе\");\n}";
+        return out.str();
+    }
+    
+    // Случайные правки корректной программы
+    string mutate(string text) {
+        static const char* const fragments[] = {
+            "switch", "(", ")", "{", "}", "case", "default", ":", ";", "break", "print",
+            "\"", "/*", "*/", "//", "/", "\n", "{I}", "{{", "123", "-1", "\\", "\"\\\"",
+            "switch (I) {", "case 1:", "99999999999"
+        };
+        size_t edits = 1 + below(16);
+        for (size_t e = 0; e < edits && !text.empty(); e++) {
+            size_t at = below(text.size());
+            size_t length = min(text.size() - at, 1 + below(64));
+            switch (below(5)) {
+                case 0:
+                    text.erase(at, length);
+                    break;
+                case 1:
+                    text.insert(at, text.substr(at, length));
+                    break;
+                case 2:
+                    text.insert(at, fragments[below(sizeof(fragments) / sizeof(fragments[0]))]);
+                    break;
+                case 3:
+                    text[at] = static_cast<char>(below(256));
+                    break;
+                default:
+                    text.insert(at, string(1 + below(32), "{}();:/\"*\\ \n"[below(12)]));
+                    break;
+            }
+        }
+        return text;
+    }
+    
+    // Враждебные входы заданного размера: каждое семейство нацелено
+    // на свой путь front end
+    static constexpr size_t FAMILY_COUNT = 10;
+    
+    string family(size_t kind, size_t bytes, string& name) {
+        string text;
+        auto repeat = [&](const string& prefix, const string& unit, const string& suffix) {
+            text = prefix;
+            while (text.size() + suffix.size() < bytes) text += unit;
+            text += suffix;
+        };
+        switch (kind) {
+            case 0:
+                name = "nesting";
+                repeat("", "switch (I) { case 1: ", "");
+                break;
+            case 1:
+                name = "comment";
+                repeat("switch (I) { /*", "* / ", "");
+                break;
+            case 2:
+                name = "slash";
+                repeat("switch (I) { ", "/ ", "");
+                break;
+            case 3:
+                name = "errors";
+                repeat("switch (I) {\n", "case : print( ; break\n", "default: print(\"x\"); }");
+                break;
+            case 4:
+                name = "labels";
+                repeat("switch (I) {\n", "case 1:\n", "default: print(\"x\"); }");
+                break;
+            case 5:
+                name = "labels-line";
+                repeat("switch (I) { ", "case 1: ", "default: print(\"x\"); }");
+                break;
+            case 6: {
+                // Ключи, кратные числу корзин хеш-таблицы на столько ключей
+                name = "collisions";
+                size_t count = bytes / 32;
+                unordered_set<int32_t> probe;
+                probe.reserve(count);
+                int64_t step = static_cast<int64_t>(probe.bucket_count());
+                ostringstream out;
+                out << "switch (I) {\n";
+                for (size_t i = 0; i < count && static_cast<int64_t>(i) * step <= INT32_MAX; i++) {
+                    out << "case " << static_cast<int64_t>(i) * step << ": print(\"x\"); break;\n";
+                }
+                out << "default: print(\"x\"); }";
+                text = out.str();
+                break;
+            }
+            case 7:
+                name = "string";
+                repeat("switch (I) { case 1: print(\"", "\\\"", "");
+                break;
+            case 8:
+                name = "template";
+                repeat("switch (I) { default: print(\"", "{I}{{", "\"); }");
+                break;
+            default:
+                name = "braces";
+                repeat("switch (I) { case 1: ", "{", "");
+                break;
+        }
+        return text;
+    }
+
+private:
+    mt19937_64 random;
+};
+
+// Сторож: вход, обработка которого не закончилась за отведенное время,
+// сохраняется (только async-signal-safe вызовы) и процесс завершается
+static const char* watchedInput = nullptr;
+static size_t watchedSize = 0;
+static char hangPath[4096];
+
+static void onWatchdog(int) {
+    int fd = open(hangPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        size_t written = 0;
+        while (written < watchedSize) {
+            ssize_t result = write(fd, watchedInput + written, watchedSize - written);
+            if (result <= 0) break;
+            written += static_cast<size_t>(result);
+        }
+        close(fd);
+    }
+    static const char message[] = "Зависание: вход сохранен в файл сторожа\n";
+    ssize_t ignored = write(STDERR_FILENO, message, sizeof(message) - 1);
+    (void)ignored;
+    _exit(3);
+}
+
+static constexpr unsigned WATCHDOG_SECONDS = 10;
+
+static Cost runWatched(const string& input) {
+    watchedInput = input.data();
+    watchedSize = input.size();
+    alarm(WATCHDOG_SECONDS);
+    Cost cost = runFrontEnd(input);
+    alarm(0);
+    return cost;
+}
+
+// Замер с повтором: разовый выброс (планировщик, промах кэша) не считается
+static bool overBudget(const string& input, const Budget& budget) {
+    if (!budget.exceeded(runWatched(input), input.size())) return false;
+    return budget.exceeded(runWatched(input), input.size());
+}
+
+// Жадная минимизация: удаляются куски (от половины входа до байта),
+// пока вход остается сверх бюджета
+static string minimize(string input, const Budget& budget) {
+    for (size_t chunk = input.size() / 2; chunk > 0; chunk /= 2) {
+        size_t at = 0;
+        while (at < input.size()) {
+            string candidate = input.substr(0, at) + input.substr(min(input.size(), at + chunk));
+            if (overBudget(candidate, budget)) {
+                input = move(candidate);
+            } else {
+                at += chunk;
+            }
+        }
+    }
+    return input;
+}
+
+static string saveRegression(const string& directory, const string& name, const string& input) {
+    mkdir(directory.c_str(), 0755);
+    char hash[17];
+    snprintf(hash, sizeof(hash), "%016llx",
+             static_cast<unsigned long long>(std::hash<string>()(input)));
+    string path = directory + "/slow-" + name + "-" + hash + ".txt";
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file) {
+        fwrite(input.data(), 1, input.size(), file);
+        fclose(file);
+    }
+    return path;
+}
+
+// Бюджет по корректным программам заданного размера
+static Budget calibrate(Generator& generator, size_t bytes) {
+    Budget budget;
+    double ns = 0, allocations = 0, total = 0;
+    for (int i = 0; i < 8; i++) {
+        string program = generator.validProgram(bytes);
+        runFrontEnd(program); // прогрев
+        Cost cost = runFrontEnd(program);
+        ns += cost.ns;
+        allocations += static_cast<double>(cost.allocations);
+        total += static_cast<double>(program.size());
+    }
+    budget.nsPerByte = ns / total;
+    budget.allocationsPerByte = allocations / total;
+    return budget;
+}
+
+static void printUsage(const char* program) {
+    cout << "Использование: " << program << " [-n N] [-s SEED] [-o КАТАЛОГ] [--size БАЙТ]\n"
+         << "  -n N          число случайных входов (по умолчанию 2000)\n"
+         << "  -s SEED       начальное значение генератора\n"
+         << "  -o КАТАЛОГ    каталог регрессий (по умолчанию regressions)\n"
+         << "  --size БАЙТ   размер враждебных входов (по умолчанию 65536)\n";
+}
+
+int main(int argc, char* argv[]) {
+    size_t iterations = 2000;
+    uint64_t seed = 1;
+    string directory = "regressions";
+    size_t size = 64 * 1024;
+    
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "-n" && hasValue) {
+            iterations = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "-s" && hasValue) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "-o" && hasValue) {
+            directory = argv[++i];
+        } else if (arg == "--size" && hasValue) {
+            size = max<size_t>(1024, strtoull(argv[++i], nullptr, 10));
+        } else {
+            printUsage(argv[0]);
+            return arg == "-h" || arg == "--help" ? 0 : 1;
+        }
+    }
+    
+    mkdir(directory.c_str(), 0755);
+    snprintf(hangPath, sizeof(hangPath), "%s/hang-%llu.txt", directory.c_str(),
+             static_cast<unsigned long long>(seed));
+    signal(SIGALRM, onWatchdog);
+    
+    Generator generator(seed);
+    Budget budget = calibrate(generator, size);
+    cout << "Бюджет: " << Budget::FIXED_NS / 1000 << " мкс + "
+         << Budget::SLACK * budget.nsPerByte << " нс/байт, "
+         << Budget::FIXED_ALLOCATIONS << " + "
+         << Budget::SLACK * budget.allocationsPerByte << " выделений/байт\n";
+    
+    size_t found = 0;
+    auto check = [&](const string& input, const string& name) {
+        if (!overBudget(input, budget)) return;
+        Cost cost = runWatched(input);
+        string smallest = minimize(input, budget);
+        string path = saveRegression(directory, name, smallest);
+        found++;
+        cout << "Сверх бюджета [" << name << "]: " << input.size() << " байт, "
+             << cost.ns / 1e6 << " мс, " << cost.allocations << " выделений; минимизирован до "
+             << smallest.size() << " байт: " << path << "\n";
+    };
+    
+    // Враждебные семейства: каждое на двух размерах, чтобы был виден рост
+    for (size_t kind = 0; kind < Generator::FAMILY_COUNT; kind++) {
+        for (size_t bytes : {size / 4, size}) {
+            string name;
+            string input = generator.family(kind, bytes, name);
+            check(input, name);
+        }
+    }
+    
+    // Случайные правки корректных программ
+    for (size_t i = 0; i < iterations; i++) {
+        string input = generator.mutate(generator.validProgram(256 + generator.below(size)));
+        check(input, "mutation");
+    }
+    
+    cout << "Проверено входов: " << iterations + 2 * Generator::FAMILY_COUNT
+         << ", сверх бюджета: " << found << "\n";
+    return found ? 2 : 0;
+}
@@ -0,0 +1,323 @@
+#include "image.h"
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+
+static const char IMAGE_MAGIC[8] = {'S', 'W', 'I', 'M', 'G', '0', '2', '\0'};
+
+// Ячейка хеш-таблицы по старшим битам мультипликативного хеша:
+// младшие биты ключей часто совпадают (например, ключи кратны 4)
+static inline uint32_t hashSlot(int32_t key, uint32_t bits) {
+    return static_cast<uint32_t>((static_cast<uint64_t>(static_cast<uint32_t>(key)) *
+                                  0x9E3779B97F4A7C15ull) >> (64 - bits));
+}
+
+// Наименьшая хеш-таблица — 2^3 ячеек; при bits == 0 сдвиг на 64 не определен
+static constexpr uint32_t HASH_MIN_BITS = 3;
+
+// Запись образа: данные дописываются в конец с нужным выравниванием
+class ImageWriter {
+public:
+    size_t append(const void* data, size_t length, size_t alignment = 4) {
+        size_t offset = reserve(length, alignment);
+        if (length) memcpy(bytes.data() + offset, data, length);
+        return offset;
+    }
+    
+    size_t reserve(size_t length, size_t alignment = 4) {
+        size_t offset = (bytes.size() + alignment - 1) / alignment * alignment;
+        bytes.resize(offset + length);
+        return offset;
+    }
+    
+    template <typename T>
+    T* at(size_t offset) {
+        return reinterpret_cast<T*>(bytes.data() + offset);
+    }
+    
+    size_t size() const { return bytes.size(); }
+    const unsigned char* data() const { return bytes.data(); }
+
+private:
+    vector<unsigned char> bytes;
+};
+
+static void writeSwitch(ImageWriter& writer, const CompiledSwitch& node, ImageSwitch& image) {
+    const CaseDispatcher& dispatcher = node.dispatcher;
+    size_t count = dispatcher.size();
+    
+    vector<int32_t> keys(count);
+    for (size_t i = 0; i < count; i++) keys[i] = dispatcher.key(static_cast<uint32_t>(i));
+    
+    image.variable = node.variable;
+    image.kind = static_cast<uint32_t>(dispatcher.kind());
+    image.keyCount = static_cast<uint32_t>(count);
+    image.hotCount = static_cast<uint32_t>(dispatcher.hotPrefix());
+    image.defaultBody = node.defaultBody;
+    image.minKey = 0;
+    image.tableOffset = 0;
+    image.tableSize = 0;
+    
+    // Ключи в той же раскладке, что и в CaseDispatcher
+    size_t blockCount = (count + 7) / 8;
+    size_t keysOffset = writer.reserve(blockCount * sizeof(KeyBlock), alignof(KeyBlock));
+    for (size_t i = 0; i < blockCount * 8; i++) {
+        writer.at<KeyBlock>(keysOffset)[i / 8].lanes[i % 8] = i < count ? keys[i] : keys[0];
+    }
+    size_t bodiesOffset = writer.append(node.caseBodies.data(), count * sizeof(uint32_t));
+    size_t tableOffset = 0;
+    
+    if (dispatcher.kind() == DispatchKind::JUMP_TABLE && count) {
+        int32_t minKey = *min_element(keys.begin(), keys.end());
+        int32_t maxKey = *max_element(keys.begin(), keys.end());
+        size_t tableSize = static_cast<size_t>(static_cast<int64_t>(maxKey) - minKey + 1);
+        vector<uint32_t> table(tableSize, CaseDispatcher::NOT_FOUND);
+        for (size_t i = 0; i < count; i++) {
+            uint32_t& slot = table[static_cast<size_t>(static_cast<int64_t>(keys[i]) - minKey)];
+            if (slot == CaseDispatcher::NOT_FOUND) slot = static_cast<uint32_t>(i);
+        }
+        image.minKey = minKey;
+        image.tableSize = static_cast<uint32_t>(tableSize);
+        tableOffset = writer.append(table.data(), tableSize * sizeof(uint32_t));
+    } else if (dispatcher.kind() == DispatchKind::HASH && count) {
+        // Открытая адресация, заполнение не больше половины
+        uint32_t bits = HASH_MIN_BITS;
+        while ((size_t(1) << bits) < count * 2) bits++;
+        vector<ImageHashSlot> table(size_t(1) << bits, ImageHashSlot{0, CaseDispatcher::NOT_FOUND});
+        for (size_t i = 0; i < count; i++) {
+            uint32_t slot = hashSlot(keys[i], bits);
+            while (table[slot].index != CaseDispatcher::NOT_FOUND && table[slot].key != keys[i]) {
+                slot = (slot + 1) & (static_cast<uint32_t>(table.size()) - 1);
+            }
+            if (table[slot].index == CaseDispatcher::NOT_FOUND) {
+                table[slot] = ImageHashSlot{keys[i], static_cast<uint32_t>(i)};
+            }
+        }
+        image.tableSize = static_cast<uint32_t>(table.size());
+        tableOffset = writer.append(table.data(), table.size() * sizeof(ImageHashSlot));
+    }
+    
+    image.keysOffset = static_cast<uint32_t>(keysOffset);
+    image.bodiesOffset = static_cast<uint32_t>(bodiesOffset);
+    image.tableOffset = static_cast<uint32_t>(tableOffset);
+}
+
+vector<KeyBlock> ProgramImage::build(const CompiledProgram& program) {
+    ImageWriter writer;
+    size_t headerOffset = writer.reserve(sizeof(ImageHeader), alignof(KeyBlock));
+    ImageHeader header = {};
+    memcpy(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+    header.root = program.root;
+    header.switchCount = static_cast<uint32_t>(program.switches.size());
+    header.bodyCount = static_cast<uint32_t>(program.bodies.size());
+    header.actionCount = static_cast<uint32_t>(program.actions.size());
+    header.outputCount = static_cast<uint32_t>(program.outputOffsets.size() - 1);
+    header.variableCount = static_cast<uint32_t>(program.variables.size());
+    header.templateCount = static_cast<uint32_t>(program.templates.size());
+    header.segmentCount = static_cast<uint32_t>(program.segments.size());
+    
+    // Имена переменных: смещения и общий блок текста
+    vector<uint32_t> variableOffsets{0};
+    string variableData;
+    for (const string& name : program.variables) {
+        variableData += name;
+        variableOffsets.push_back(static_cast<uint32_t>(variableData.size()));
+    }
+    size_t variableOffsetsOffset = writer.append(variableOffsets.data(), variableOffsets.size() * sizeof(uint32_t));
+    size_t variableDataOffset = writer.append(variableData.data(), variableData.size(), 1);
+    
+    size_t outputOffsetsOffset = writer.append(program.outputOffsets.data(),
+                                               program.outputOffsets.size() * sizeof(uint32_t));
+    size_t outputDataOffset = writer.append(program.outputData.data(), program.outputData.size(), 1);
+    size_t bodiesOffset = writer.append(program.bodies.data(), program.bodies.size() * sizeof(CompiledBody));
+    size_t actionsOffset = writer.append(program.actions.data(), program.actions.size() * sizeof(CompiledAction));
+    size_t templatesOffset = writer.append(program.templates.data(),
+                                           program.templates.size() * sizeof(CompiledTemplate));
+    size_t segmentsOffset = writer.append(program.segments.data(),
+                                          program.segments.size() * sizeof(CompiledSegment));
+    
+    vector<ImageSwitch> switches(program.switches.size());
+    for (size_t i = 0; i < switches.size(); i++) {
+        writeSwitch(writer, program.switches[i], switches[i]);
+    }
+    size_t switchesOffset = writer.append(switches.data(), switches.size() * sizeof(ImageSwitch));
+    
+    // Смещения 32-битные: образ больше 4 ГБ не поддерживается
+    if (writer.size() > UINT32_MAX) {
+        return {};
+    }
+    
+    header.size = writer.size();
+    header.switchesOffset = static_cast<uint32_t>(switchesOffset);
+    header.bodiesOffset = static_cast<uint32_t>(bodiesOffset);
+    header.actionsOffset = static_cast<uint32_t>(actionsOffset);
+    header.templatesOffset = static_cast<uint32_t>(templatesOffset);
+    header.segmentsOffset = static_cast<uint32_t>(segmentsOffset);
+    header.outputOffsetsOffset = static_cast<uint32_t>(outputOffsetsOffset);
+    header.outputDataOffset = static_cast<uint32_t>(outputDataOffset);
+    header.variableOffsetsOffset = static_cast<uint32_t>(variableOffsetsOffset);
+    header.variableDataOffset = static_cast<uint32_t>(variableDataOffset);
+    *writer.at<ImageHeader>(headerOffset) = header;
+    
+    vector<KeyBlock> storage((writer.size() + sizeof(KeyBlock) - 1) / sizeof(KeyBlock));
+    memcpy(storage.data(), writer.data(), writer.size());
+    return storage;
+}
+
+ProgramImage::ProgramImage(const void* data, size_t imageSize)
+    : base(static_cast<const unsigned char*>(data)), size(imageSize) {
+    // Образ может прийти из другого процесса: смещения и индексы
+    // проверяются один раз, чтобы вычисление обходилось без проверок.
+    // Ацикличность DAG не проверяется — ее обеспечивает Compiler.
+    if (size < sizeof(ImageHeader) || reinterpret_cast<uintptr_t>(base) % alignof(KeyBlock)) return;
+    const ImageHeader& h = header();
+    if (memcmp(h.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0 || h.size > size) return;
+    
+    if (!checkRange(h.switchesOffset, uint64_t(h.switchCount) * sizeof(ImageSwitch)) ||
+        !checkRange(h.bodiesOffset, uint64_t(h.bodyCount) * sizeof(CompiledBody)) ||
+        !checkRange(h.actionsOffset, uint64_t(h.actionCount) * sizeof(CompiledAction)) ||
+        !checkRange(h.templatesOffset, uint64_t(h.templateCount) * sizeof(CompiledTemplate)) ||
+        !checkRange(h.segmentsOffset, uint64_t(h.segmentCount) * sizeof(CompiledSegment)) ||
+        !checkRange(h.outputOffsetsOffset, (uint64_t(h.outputCount) + 1) * sizeof(uint32_t)) ||
+        !checkRange(h.variableOffsetsOffset, (uint64_t(h.variableCount) + 1) * sizeof(uint32_t)) ||
+        (h.switchCount && h.root >= h.switchCount)) {
+        return;
+    }
+    
+    const uint32_t* outputOffsets = at<uint32_t>(h.outputOffsetsOffset);
+    for (uint32_t i = 0; i < h.outputCount; i++) {
+        if (outputOffsets[i] > outputOffsets[i + 1]) return;
+    }
+    if (!checkRange(h.outputDataOffset, outputOffsets[h.outputCount])) return;
+    
+    const uint32_t* variableOffsets = at<uint32_t>(h.variableOffsetsOffset);
+    for (uint32_t i = 0; i < h.variableCount; i++) {
+        if (variableOffsets[i] > variableOffsets[i + 1]) return;
+    }
+    if (!checkRange(h.variableDataOffset, variableOffsets[h.variableCount])) return;
+    
+    const CompiledBody* bodies = at<CompiledBody>(h.bodiesOffset);
+    for (uint32_t i = 0; i < h.bodyCount; i++) {
+        if (uint64_t(bodies[i].firstAction) + bodies[i].actionCount > h.actionCount) return;
+    }
+    
+    const CompiledAction* actions = at<CompiledAction>(h.actionsOffset);
+    for (uint32_t i = 0; i < h.actionCount; i++) {
+        uint32_t limit = actions[i].kind == CompiledAction::OUTPUT ? h.outputCount
+                       : actions[i].kind == CompiledAction::SWITCH ? h.switchCount
+                       : actions[i].kind == CompiledAction::TEMPLATE ? h.templateCount : 0;
+        if (actions[i].index >= limit) return;
+    }
+    
+    // Подстановка идет в буфер на стеке: длина шаблона проверяется здесь
+    const CompiledSegment* segments = at<CompiledSegment>(h.segmentsOffset);
+    for (uint32_t i = 0; i < h.segmentCount; i++) {
+        uint32_t limit = segments[i].kind == CompiledSegment::LITERAL ? h.outputCount
+                       : segments[i].kind == CompiledSegment::VARIABLE ? h.variableCount : 0;
+        if (segments[i].index >= limit) return;
+    }
+    const CompiledTemplate* templates = at<CompiledTemplate>(h.templatesOffset);
+    for (uint32_t i = 0; i < h.templateCount; i++) {
+        if (uint64_t(templates[i].firstSegment) + templates[i].segmentCount > h.segmentCount) return;
+        uint64_t length = 0;
+        for (uint32_t s = 0; s < templates[i].segmentCount; s++) {
+            const CompiledSegment& segment = segments[templates[i].firstSegment + s];
+            length += segment.kind == CompiledSegment::LITERAL
+                ? outputOffsets[segment.index + 1] - outputOffsets[segment.index] : 11;
+        }
+        if (length > CompiledTemplate::MAX_LENGTH) return;
+    }
+    
+    const ImageSwitch* switches = at<ImageSwitch>(h.switchesOffset);
+    for (uint32_t i = 0; i < h.switchCount; i++) {
+        const ImageSwitch& node = switches[i];
+        uint64_t tableBytes = node.kind == static_cast<uint32_t>(DispatchKind::HASH)
+            ? uint64_t(node.tableSize) * sizeof(ImageHashSlot) : uint64_t(node.tableSize) * sizeof(uint32_t);
+        if (node.variable >= h.variableCount || node.kind > static_cast<uint32_t>(DispatchKind::HASH) ||
+            node.keysOffset % alignof(KeyBlock) || node.hotCount > min<uint32_t>(node.keyCount, 8) ||
+            !checkRange(node.keysOffset, (uint64_t(node.keyCount) + 7) / 8 * sizeof(KeyBlock)) ||
+            !checkRange(node.bodiesOffset, uint64_t(node.keyCount) * sizeof(uint32_t)) ||
+            !checkRange(node.tableOffset, tableBytes) ||
+            (node.defaultBody != CompiledSwitch::NO_BODY && node.defaultBody >= h.bodyCount)) {
+            return;
+        }
+        if (node.kind == static_cast<uint32_t>(DispatchKind::HASH) &&
+            (node.tableSize < (1u << HASH_MIN_BITS) || (node.tableSize & (node.tableSize - 1)))) {
+            return;
+        }
+        const uint32_t* caseBodies = at<uint32_t>(node.bodiesOffset);
+        for (uint32_t k = 0; k < node.keyCount; k++) {
+            if (caseBodies[k] >= h.bodyCount) return;
+        }
+        
+        // Поиск проверяет последний блок ключей целиком: дополнение должно
+        // повторять первый ключ, чтобы совпадение не дало индекс за keyCount
+        const KeyBlock* blocks = at<KeyBlock>(node.keysOffset);
+        for (uint64_t k = node.keyCount; k % 8; k++) {
+            if (blocks[k / 8].lanes[k % 8] != blocks[0].lanes[0]) return;
+        }
+        
+        if (node.kind != static_cast<uint32_t>(DispatchKind::LINEAR)) {
+            bool hasEmptySlot = false;
+            for (uint32_t t = 0; t < node.tableSize; t++) {
+                uint32_t index = node.kind == static_cast<uint32_t>(DispatchKind::HASH)
+                    ? at<ImageHashSlot>(node.tableOffset)[t].index : at<uint32_t>(node.tableOffset)[t];
+                if (index != CaseDispatcher::NOT_FOUND && index >= node.keyCount) return;
+                hasEmptySlot |= index == CaseDispatcher::NOT_FOUND;
+            }
+            // Без пустой ячейки поиск отсутствующего ключа не остановится
+            if (node.kind == static_cast<uint32_t>(DispatchKind::HASH) && !hasEmptySlot) return;
+        }
+    }
+    
+    ok = true;
+}
+
+string_view ProgramImage::variable(uint32_t index) const {
+    const uint32_t* offsets = at<uint32_t>(header().variableOffsetsOffset);
+    return string_view(at<char>(header().variableDataOffset) + offsets[index],
+                       offsets[index + 1] - offsets[index]);
+}
+
+int ProgramImage::variableIndex(string_view name) const {
+    for (uint32_t i = 0; i < header().variableCount; i++) {
+        if (variable(i) == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+string_view ProgramImage::output(uint32_t index) const {
+    const uint32_t* offsets = at<uint32_t>(header().outputOffsetsOffset);
+    return string_view(at<char>(header().outputDataOffset) + offsets[index],
+                       offsets[index + 1] - offsets[index]);
+}
+
+uint32_t ProgramImage::find(const ImageSwitch& node, int32_t value) const {
+    const KeyBlock* blocks = at<KeyBlock>(node.keysOffset);
+    if (node.hotCount) {
+        uint32_t index = findKeyInBlock(blocks[0], value);
+        if (index != CaseDispatcher::NOT_FOUND) return index;
+    }
+    
+    switch (static_cast<DispatchKind>(node.kind)) {
+        case DispatchKind::LINEAR:
+            return node.keyCount == 0 ? CaseDispatcher::NOT_FOUND
+                                      : findKeyVector(blocks, node.keyCount, value);
+        case DispatchKind::JUMP_TABLE: {
+            uint64_t offset = static_cast<uint64_t>(static_cast<int64_t>(value) - node.minKey);
+            return offset < node.tableSize ? at<uint32_t>(node.tableOffset)[offset]
+                                           : CaseDispatcher::NOT_FOUND;
+        }
+        case DispatchKind::HASH: {
+            const ImageHashSlot* table = at<ImageHashSlot>(node.tableOffset);
+            uint32_t mask = node.tableSize - 1;
+            for (uint32_t slot = hashSlot(value, __builtin_ctz(node.tableSize));; slot = (slot + 1) & mask) {
+                if (table[slot].index == CaseDispatcher::NOT_FOUND || table[slot].key == value) {
+                    return table[slot].index;
+                }
+            }
+        }
+    }
+    return CaseDispatcher::NOT_FOUND;
+}
@@ -0,0 +1,134 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include "compiler.h"
+#include "dispatch.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Плоский образ скомпилированной программы. Все ссылки внутри образа —
+// смещения от его начала, поэтому образ можно отобразить в память любого
+// процесса по любому адресу (например, из memfd) и вычислять прямо по нему,
+// без распаковки. Начало образа и таблицы ключей выровнены на 32 байта.
+
+struct ImageHeader {
+    char magic[8];
+    uint64_t size;                 // полный размер образа в байтах
+    uint32_t root;
+    uint32_t switchCount;
+    uint32_t bodyCount;
+    uint32_t actionCount;
+    uint32_t outputCount;
+    uint32_t variableCount;
+    uint32_t templateCount;
+    uint32_t segmentCount;
+    uint32_t switchesOffset;       // ImageSwitch[switchCount]
+    uint32_t bodiesOffset;         // CompiledBody[bodyCount]
+    uint32_t actionsOffset;        // CompiledAction[actionCount]
+    uint32_t templatesOffset;      // CompiledTemplate[templateCount]
+    uint32_t segmentsOffset;       // CompiledSegment[segmentCount]
+    uint32_t outputOffsetsOffset;  // uint32_t[outputCount + 1], от outputDataOffset
+    uint32_t outputDataOffset;
+    uint32_t variableOffsetsOffset; // uint32_t[variableCount + 1], от variableDataOffset
+    uint32_t variableDataOffset;
+};
+
+// Узел switch в образе
+struct ImageSwitch {
+    uint32_t variable;
+    uint32_t kind;          // DispatchKind
+    uint32_t keyCount;
+    uint32_t hotCount;      // горячий префикс (первый блок ключей)
+    uint32_t keysOffset;    // KeyBlock[(keyCount + 7) / 8]
+    uint32_t bodiesOffset;  // uint32_t[keyCount]
+    uint32_t defaultBody;
+    int32_t minKey;         // для JUMP_TABLE
+    uint32_t tableOffset;   // uint32_t[tableSize] или ImageHashSlot[tableSize]
+    uint32_t tableSize;
+};
+
+// Ячейка хеш-таблицы с открытой адресацией
+struct ImageHashSlot {
+    int32_t key;
+    uint32_t index;  // CaseDispatcher::NOT_FOUND — пустая ячейка
+};
+
+// Представление образа только для чтения. Не владеет памятью.
+class ProgramImage {
+public:
+    // Построение образа. Хранилище из KeyBlock обеспечивает выравнивание;
+    // размер образа — header().size. Пустой результат — образ больше 4 ГБ.
+    static std::vector<KeyBlock> build(const CompiledProgram& program);
+    
+    ProgramImage(const void* data, size_t size);
+    
+    // Проверка заголовка и границ таблиц
+    bool valid() const { return ok; }
+    
+    const ImageHeader& header() const { return *at<ImageHeader>(0); }
+    std::string_view variable(uint32_t index) const;
+    int variableIndex(std::string_view name) const;
+    std::string_view output(uint32_t index) const;
+    
+    // Индекс ключа в узле switch или CaseDispatcher::NOT_FOUND
+    uint32_t find(const ImageSwitch& node, int32_t value) const;
+    
+    // Вычисление для набора значений; emit(string_view) получает строки
+    // print. sample, если задан, получает время поиска case и вывода.
+    template <typename Emit>
+    void evaluate(const int32_t* values, Emit&& emit, LatencySample* sample = nullptr) const {
+        if (!header().switchCount) return;
+        if (sample) {
+            evaluateSwitch<true>(header().root, values, emit, sample);
+        } else {
+            evaluateSwitch<false>(header().root, values, emit, nullptr);
+        }
+    }
+
+private:
+    const unsigned char* base;
+    size_t size;
+    bool ok = false;
+    
+    template <typename T>
+    const T* at(uint32_t offset) const {
+        return reinterpret_cast<const T*>(base + offset);
+    }
+    
+    bool checkRange(uint32_t offset, uint64_t bytes) const {
+        return offset <= size && bytes <= size - offset;
+    }
+    
+    template <bool TIMED, typename Emit>
+    void evaluateSwitch(uint32_t index, const int32_t* values, Emit& emit, LatencySample* sample) const {
+        const ImageSwitch& node = at<ImageSwitch>(header().switchesOffset)[index];
+        enterPhase<TIMED>(sample, LatencyKind::LOOKUP);
+        uint32_t keyIndex = find(node, values[node.variable]);
+        
+        uint32_t bodyIndex = keyIndex != CaseDispatcher::NOT_FOUND
+            ? at<uint32_t>(node.bodiesOffset)[keyIndex] : node.defaultBody;
+        if (bodyIndex == CompiledSwitch::NO_BODY) return;
+        
+        const CompiledBody& body = at<CompiledBody>(header().bodiesOffset)[bodyIndex];
+        const CompiledAction* actions = at<CompiledAction>(header().actionsOffset) + body.firstAction;
+        for (uint32_t i = 0; i < body.actionCount; i++) {
+            if (actions[i].kind == CompiledAction::OUTPUT) {
+                enterPhase<TIMED>(sample, LatencyKind::EMIT);
+                emit(output(actions[i].index));
+            } else if (actions[i].kind == CompiledAction::TEMPLATE) {
+                enterPhase<TIMED>(sample, LatencyKind::EMIT);
+                const CompiledTemplate& compiled = at<CompiledTemplate>(header().templatesOffset)[actions[i].index];
+                renderTemplate(at<CompiledSegment>(header().segmentsOffset) + compiled.firstSegment,
+                               compiled.segmentCount, values,
+                               [this](uint32_t text) { return output(text); }, emit);
+            } else {
+                evaluateSwitch<TIMED>(actions[i].index, values, emit, sample);
+            }
+        }
+    }
+};
+
+#endif // IMAGE_H
@@ -0,0 +1,207 @@
+#include "latency.h"
+#include <algorithm>
+#include <csignal>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <unistd.h>
+
+using namespace std;
+
+atomic<bool> Latency::active{false};
+
+// Логарифмически-линейная гистограмма. Значения меньше 128 нс хранятся
+// точно; выше каждая степень двойки делится на 64 равные корзины, поэтому
+// ширина корзины не больше 1/64 ее нижней границы.
+struct LatencyHistogram {
+    static constexpr unsigned SUB_BITS = 6;
+    static constexpr uint64_t SUB_COUNT = uint64_t(1) << SUB_BITS; // 64
+    static constexpr size_t BUCKET_COUNT = (64 - SUB_BITS + 1) * SUB_COUNT;
+    
+    // Пишет только поток-владелец (load + store без read-modify-write),
+    // читают вывод и поток SIGUSR1
+    atomic<uint64_t> counts[BUCKET_COUNT] = {};
+    atomic<uint64_t> sum{0};
+    atomic<uint64_t> maximum{0};
+    
+    static size_t bucket(uint64_t value) {
+        if (value < 2 * SUB_COUNT) return static_cast<size_t>(value);
+        unsigned shift = 63 - static_cast<unsigned>(__builtin_clzll(value)) - SUB_BITS;
+        return static_cast<size_t>(shift * SUB_COUNT + (value >> shift));
+    }
+    
+    // Наибольшее значение, попадающее в корзину
+    static uint64_t highestInBucket(size_t index) {
+        if (index < 2 * SUB_COUNT) return index;
+        unsigned shift = static_cast<unsigned>(index / SUB_COUNT) - 1;
+        uint64_t lowest = (index % SUB_COUNT + SUB_COUNT) << shift;
+        return lowest + (uint64_t(1) << shift) - 1;
+    }
+    
+    static void add(atomic<uint64_t>& counter, uint64_t value) {
+        counter.store(counter.load(memory_order_relaxed) + value, memory_order_relaxed);
+    }
+    
+    void reset() {
+        for (auto& count : counts) count.store(0, memory_order_relaxed);
+        sum.store(0, memory_order_relaxed);
+        maximum.store(0, memory_order_relaxed);
+    }
+    
+    void record(uint64_t value) {
+        add(counts[bucket(value)], 1);
+        add(sum, value);
+        if (value > maximum.load(memory_order_relaxed)) {
+            maximum.store(value, memory_order_relaxed);
+        }
+    }
+};
+
+// Гистограммы одного потока
+struct LatencyBuffer {
+    LatencyHistogram histograms[static_cast<size_t>(LatencyKind::COUNT)];
+};
+
+// Реестр буферов, как у трассировки: блокировка только при первой
+// записи в потоке и при выводе; буферы завершившихся потоков остаются
+static mutex registryMutex;
+static vector<unique_ptr<LatencyBuffer>> registry;
+
+static LatencyBuffer& threadBuffer() {
+    thread_local LatencyBuffer* buffer = nullptr;
+    if (!buffer) {
+        lock_guard<mutex> lock(registryMutex);
+        registry.push_back(make_unique<LatencyBuffer>());
+        buffer = registry.back().get();
+    }
+    return *buffer;
+}
+
+void Latency::record(LatencyKind kind, uint64_t nanoseconds) {
+    threadBuffer().histograms[static_cast<size_t>(kind)].record(nanoseconds);
+}
+
+void Latency::record(uint64_t begin, LatencySample& sample) {
+    uint64_t end = now();
+    sample.finish(end);
+    LatencyBuffer& buffer = threadBuffer();
+    buffer.histograms[static_cast<size_t>(LatencyKind::EVALUATE)].record(end - begin);
+    buffer.histograms[static_cast<size_t>(LatencyKind::LOOKUP)].record(sample.lookup);
+    buffer.histograms[static_cast<size_t>(LatencyKind::EMIT)].record(sample.emit);
+}
+
+// Выравнивание по ширине в символах, а не в байтах UTF-8
+static string pad(const string& text, size_t width, bool alignLeft = false) {
+    size_t characters = 0;
+    for (char c : text) {
+        if ((static_cast<unsigned char>(c) & 0xC0) != 0x80) characters++;
+    }
+    string fill(width > characters ? width - characters : 0, ' ');
+    return alignLeft ? text + fill : fill + text;
+}
+
+void Latency::write(ostream& out) {
+    static const char* const names[] = {"вычисление", "поиск case", "вывод"};
+    static const double percentiles[] = {0.5, 0.9, 0.99, 0.999};
+    
+    // Сумма гистограмм всех потоков. Счетчики читаются во время записи,
+    // поэтому снимок по SIGUSR1 может отставать на несколько вычислений.
+    vector<uint64_t> counts(LatencyHistogram::BUCKET_COUNT);
+    ostringstream report;
+    report << fixed << setprecision(0);
+    {
+        lock_guard<mutex> lock(registryMutex);
+        for (size_t kind = 0; kind < static_cast<size_t>(LatencyKind::COUNT); kind++) {
+            fill(counts.begin(), counts.end(), 0);
+            uint64_t total = 0;
+            uint64_t sum = 0;
+            uint64_t maximum = 0;
+            for (const auto& buffer : registry) {
+                const LatencyHistogram& histogram = buffer->histograms[kind];
+                for (size_t b = 0; b < counts.size(); b++) {
+                    counts[b] += histogram.counts[b].load(memory_order_relaxed);
+                }
+                sum += histogram.sum.load(memory_order_relaxed);
+                maximum = max(maximum, histogram.maximum.load(memory_order_relaxed));
+            }
+            for (uint64_t count : counts) total += count;
+            if (!total) continue;
+            
+            report << pad(names[kind], 12, true) << setw(12) << total
+                   << setw(10) << static_cast<double>(sum) / total;
+            size_t bucket = 0;
+            uint64_t seen = counts[0];
+            for (double p : percentiles) {
+                // Ранг процентиля: наименьшее значение, не меньшее доли p
+                uint64_t rank = max<uint64_t>(1, static_cast<uint64_t>(p * total + 0.999999));
+                while (seen < rank) seen += counts[++bucket];
+                report << setw(10) << min(LatencyHistogram::highestInBucket(bucket), maximum);
+            }
+            report << setw(12) << maximum << "\n";
+        }
+    }
+    
+    if (report.tellp() == 0) return;
+    out << "\n=== ЗАДЕРЖКИ ВЫЧИСЛЕНИЙ, нс (процесс " << getpid() << ") ===\n"
+        << pad("", 12) << pad("число", 12) << pad("среднее", 10)
+        << setw(10) << "p50" << setw(10) << "p90" << setw(10) << "p99" << setw(10) << "p99.9"
+        << setw(12) << "max" << "\n"
+        << report.str() << flush;
+}
+
+// Поток вывода по SIGUSR1: сигнал заблокирован во всех потоках
+// и принимается синхронно, поэтому вывод не ограничен async-signal-safe
+static void startSignalThread() {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    
+    thread([signals] {
+        int received;
+        while (sigwait(&signals, &received) == 0) {
+            Latency::write(cerr);
+        }
+    }).detach();
+}
+
+// fork() во время вывода или первой записи в другом потоке оставил бы
+// registryMutex захваченным в потомке навсегда: реестр блокируется
+// на время fork, и потомок получает его в согласованном состоянии
+static void lockRegistryBeforeFork() {
+    registryMutex.lock();
+}
+
+static void unlockRegistryInParent() {
+    registryMutex.unlock();
+}
+
+static void resetRegistryInChild() {
+    // Буферы остаются (на них указывает thread_local потока, выполнившего
+    // fork), но измерения родителя не повторяются в выводе потомка
+    for (auto& buffer : registry) {
+        for (auto& histogram : buffer->histograms) histogram.reset();
+    }
+    registryMutex.unlock();
+}
+
+void Latency::enable() {
+    active.store(true, memory_order_relaxed);
+    static once_flag forkHandlers;
+    call_once(forkHandlers, [] {
+        pthread_atfork(lockRegistryBeforeFork, unlockRegistryInParent, resetRegistryInChild);
+    });
+    startSignalThread();
+}
+
+void Latency::afterFork() {
+    if (!enabled()) return;
+    // Гистограммы уже обнулены обработчиком pthread_atfork; поток
+    // SIGUSR1 родителя в потомок не переходит
+    startSignalThread();
+}
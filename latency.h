@@ -0,0 +1,105 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+// Гистограммы задержек вычислений (--latency): полное время каждого
+// вычисления, время поиска case и время вывода. Гистограммы
+// логарифмически-линейные, как HDR Histogram: относительная погрешность
+// значения не больше 1/64 на всем диапазоне. Каждый поток пишет в свои
+// счетчики без блокировок; процентили выводятся при выходе и по SIGUSR1.
+enum class LatencyKind {
+    EVALUATE, // вычисление целиком
+    LOOKUP,   // выбор case по значению (сумма по вложенным switch)
+    EMIT,     // передача вывода получателю (терминал, буфер, сокет)
+    COUNT
+};
+
+// Части одного вычисления, накопленные по вложенным switch. Время
+// делится на фазы: часы читаются только при смене фазы, а не вокруг
+// каждого поиска и каждой строки (на типичное вычисление — три чтения).
+struct LatencySample {
+    uint64_t lookup = 0;
+    uint64_t emit = 0;
+    uint64_t mark;                          // начало текущей фазы
+    LatencyKind phase = LatencyKind::LOOKUP; // вычисление начинается с поиска
+    
+    explicit LatencySample(uint64_t begin) : mark(begin) {}
+    
+    inline void enter(LatencyKind next);
+    // Завершение последней фазы в момент end
+    void finish(uint64_t end) {
+        (phase == LatencyKind::LOOKUP ? lookup : emit) += end - mark;
+    }
+};
+
+class Latency {
+public:
+    static bool enabled() { return active.load(std::memory_order_relaxed); }
+    
+    // Включение записи. SIGUSR1 блокируется в вызывающем потоке (и в
+    // потоках, созданных после), а отдельный поток ждет его через sigwait
+    // и выводит процентили, не прерывая вычислений. Вызывать до создания
+    // других потоков. Реестр гистограмм защищен и на время fork()
+    // (pthread_atfork), а потомок начинает с пустых гистограмм.
+    static void enable();
+    // В дочернем процессе после fork(): свой поток SIGUSR1
+    static void afterFork();
+    
+    static uint64_t now() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+    
+    static void record(LatencyKind kind, uint64_t nanoseconds);
+    // Вычисление целиком и его части; завершает последнюю фазу sample
+    static void record(uint64_t begin, LatencySample& sample);
+    
+    // Вычисление evaluate(LatencySample*) с записью в гистограммы процесса.
+    // Пока запись выключена, evaluate получает nullptr и часы не читаются.
+    // Для кода приложения: библиотечные вычисления глобальный флаг не читают.
+    template <typename Evaluate>
+    static void measure(Evaluate&& evaluate);
+    
+    // p50/p90/p99/p99.9/max по всем потокам процесса
+    static void write(std::ostream& out);
+
+private:
+    static std::atomic<bool> active;
+};
+
+template <typename Evaluate>
+void Latency::measure(Evaluate&& evaluate) {
+    if (!enabled()) {
+        evaluate(nullptr);
+        return;
+    }
+    uint64_t begin = now();
+    LatencySample sample(begin);
+    evaluate(&sample);
+    record(begin, sample);
+}
+
+void LatencySample::enter(LatencyKind next) {
+    if (next == phase) return;
+    uint64_t now = Latency::now();
+    finish(now);
+    mark = now;
+    phase = next;
+}
+
+// Смена фазы только в измеряемом вычислении
+template <bool TIMED>
+inline void enterPhase(LatencySample* sample, LatencyKind phase) {
+    if constexpr (TIMED) {
+        sample->enter(phase);
+    } else {
+        (void)sample;
+        (void)phase;
+    }
+}
+
+#endif // LATENCY_H
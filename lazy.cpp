@@ -0,0 +1,255 @@
+#include "lazy.h"
+#include "scanner.h"
+#include "trace.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_set>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+static inline bool isIdentifierStart(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static inline bool isIdentifierChar(char c) {
+    return isIdentifierStart(c) || (c >= '0' && c <= '9');
+}
+
+// Пропуск пробелов и комментариев; false — незавершенный комментарий
+static bool skipSpace(string_view text, size_t& position) {
+    while (position < text.size()) {
+        char c = text[position];
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            position++;
+        } else if (c == '/' && position + 1 < text.size() && text[position + 1] == '/') {
+            size_t end = text.find('\n', position);
+            position = end == string_view::npos ? text.size() : end + 1;
+        } else if (c == '/' && position + 1 < text.size() && text[position + 1] == '*') {
+            size_t end = text.find("*/", position + 2);
+            if (end == string_view::npos) return false;
+            position = end + 2;
+        } else {
+            break;
+        }
+    }
+    return true;
+}
+
+static string_view readWord(string_view text, size_t& position) {
+    size_t begin = position;
+    while (position < text.size() && isIdentifierChar(text[position])) position++;
+    return text.substr(begin, position - begin);
+}
+
+static bool expect(string_view text, size_t& position, char c) {
+    if (!skipSpace(text, position) || position >= text.size() || text[position] != c) return false;
+    position++;
+    return true;
+}
+
+bool CaseIndex::build(string_view source) {
+    TRACE_SCOPE("index cases");
+    text = source;
+    cases.clear();
+    variableName.clear();
+    switchVariables.clear();
+    
+    // switch (<Переменная>) {
+    size_t position = 0;
+    if (!skipSpace(text, position) || readWord(text, position) != "switch" ||
+        !expect(text, position, '(') || !skipSpace(text, position)) {
+        return false;
+    }
+    variableOffset = position;
+    string_view variable = readWord(text, position);
+    if (variable.empty() || !isIdentifierStart(variable[0]) ||
+        !expect(text, position, ')') || !expect(text, position, '{')) {
+        return false;
+    }
+    variableName = string(variable);
+    switchVariables.push_back(variableName);
+    unordered_set<string_view> seenVariables{variable};
+    
+    // Заголовки case и default ищутся только на глубине 1: case вложенных
+    // switch лежат внутри их фигурных скобок
+    int depth = 1;
+    bool hasDefault = false;
+    while (position < text.size()) {
+        char c = text[position];
+        if (c == '"') {
+            // Строка; обратная косая черта экранирует следующий символ.
+            // Кавычка ищется memchr, экранирована она при нечетном
+            // числе косых черт перед ней.
+            size_t contentBegin = ++position;
+            while (true) {
+                const void* found = memchr(text.data() + position, '"', text.size() - position);
+                if (!found) return false;
+                size_t quote = static_cast<const char*>(found) - text.data();
+                size_t slashes = quote;
+                while (slashes > contentBegin && text[slashes - 1] == '\\') slashes--;
+                position = quote + 1;
+                if ((quote - slashes) % 2 == 0) break;
+            }
+        } else if (c == '/' || c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            size_t before = position;
+            if (!skipSpace(text, position)) return false;
+            if (position == before) return false; // одиночный '/'
+        } else if (c == '{') {
+            depth++;
+            position++;
+        } else if (c == '}') {
+            if (--depth == 0) break;
+            position++;
+        } else if (isIdentifierStart(c)) {
+            size_t begin = position;
+            string_view word = readWord(text, position);
+            
+            // Переменные вложенных switch нужны для вывода значений
+            if (word == "switch") {
+                if (!expect(text, position, '(') || !skipSpace(text, position)) return false;
+                string_view nested = readWord(text, position);
+                if (nested.empty() || !isIdentifierStart(nested[0])) return false;
+                if (seenVariables.insert(nested).second) switchVariables.emplace_back(nested);
+                continue;
+            }
+            if (depth != 1) continue;
+            
+            if (word == "case") {
+                // После default case недопустим
+                if (hasDefault || !skipSpace(text, position)) return false;
+                size_t digitsBegin = position;
+                int64_t key = 0;
+                while (position < text.size() && text[position] >= '0' && text[position] <= '9') {
+                    key = key * 10 + (text[position++] - '0');
+                    if (key > INT32_MAX) return false;
+                }
+                if (position == digitsBegin || !expect(text, position, ':')) return false;
+                cases.push_back(CaseHeader{static_cast<int32_t>(key), begin});
+            } else if (word == "default") {
+                if (hasDefault) return false;
+                hasDefault = true;
+                defaultBegin = begin;
+            }
+        } else {
+            position++;
+        }
+    }
+    
+    // Грамматика требует default; после switch допустимы только комментарии
+    if (depth != 0 || !hasDefault) return false;
+    switchEnd = position;
+    position++;
+    return skipSpace(text, position) && position == text.size();
+}
+
+void CaseIndex::location(size_t offset, Cursor& cursor, size_t& line, size_t& column) const {
+    if (offset < cursor.offset) cursor = Cursor();
+    const char* begin = text.data() + cursor.offset;
+    const char* end = text.data() + offset;
+    size_t newlines = static_cast<size_t>(count(begin, end, '\n'));
+    if (newlines) {
+        cursor.line += newlines;
+        cursor.lineStart = static_cast<size_t>(
+            static_cast<const char*>(memrchr(begin, '\n', end - begin)) - text.data()) + 1;
+    }
+    cursor.offset = offset;
+    line = cursor.line;
+    column = offset - cursor.lineStart + 1;
+}
+
+unique_ptr<ASTNode> CaseIndex::parseSelected(int32_t value, ErrorHandler& errors) const {
+    TRACE_SCOPE("parse selected");
+    auto switchNode = make_unique<SwitchNode>();
+    Cursor cursor;
+    size_t line;
+    size_t column;
+    location(variableOffset, cursor, line, column);
+    switchNode->variable = Token(TokenType::IDENTIFIER, variableName,
+                                 static_cast<int>(line), static_cast<int>(column));
+    
+    // Тело case — от его ключевого слова до следующего заголовка
+    size_t selected = cases.size();
+    size_t duplicate = cases.size();
+    for (size_t i = 0; i < cases.size() && duplicate == cases.size(); i++) {
+        if (cases[i].key != value) continue;
+        (selected == cases.size() ? selected : duplicate) = i;
+    }
+    
+    // Каждое тело разбирается отдельно: от заголовка до следующего.
+    // Case без break проваливается в следующий, поэтому разбор идет
+    // дальше до break или до default включительно.
+    auto clauseParser = [&](size_t clause, auto&& parse) {
+        size_t begin = clause < cases.size() ? cases[clause].begin : defaultBegin;
+        size_t end = clause + 1 < cases.size() ? cases[clause + 1].begin
+                   : clause < cases.size() ? defaultBegin : switchEnd;
+        Scanner scanner(text.substr(begin, end - begin));
+        location(begin, cursor, line, column);
+        scanner.setLocation(line, column);
+        Parser parser(scanner, errors);
+        return parse(parser);
+    };
+    
+    size_t clause = selected;
+    for (; clause < cases.size(); clause++) {
+        auto caseNode = clauseParser(clause, [](Parser& parser) { return parser.parseCaseClause(); });
+        bool hasBreak = caseNode->hasBreak;
+        switchNode->cases.push_back(move(caseNode));
+        if (hasBreak || errors.hasErrors()) break;
+    }
+    if (clause == cases.size()) {
+        switchNode->defaultCase = clauseParser(clause, [](Parser& parser) { return parser.parseDefaultClause(); });
+    }
+    
+    // Повтор выполняемого значения — ошибка и при отложенном разборе;
+    // как и при полном разборе, она указывает на второе вхождение.
+    // Повтор среди разобранных тел найдет семантический анализ.
+    if (duplicate < cases.size() && duplicate > clause) {
+        size_t keyOffset = cases[duplicate].begin + 4;
+        skipSpace(text, keyOffset);
+        location(keyOffset, cursor, line, column);
+        const auto& first = static_cast<const CaseNode&>(*switchNode->cases.front());
+        errors.addError("Повторяющееся значение case: " + first.value.lexeme,
+                        static_cast<int>(line), static_cast<int>(column));
+    }
+    return switchNode;
+}
+
+MappedFile::~MappedFile() {
+    if (data && size) {
+        munmap(const_cast<char*>(data), size);
+    }
+}
+
+bool MappedFile::open(const string& filename) {
+    TRACE_SCOPE("map file");
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        close(fd);
+        return false;
+    }
+    
+    size = static_cast<size_t>(info.st_size);
+    if (size == 0) {
+        data = "";
+        close(fd);
+        return true;
+    }
+    
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        size = 0;
+        return false;
+    }
+    // Предварительный проход читает файл последовательно
+    madvise(mapped, size, MADV_SEQUENTIAL);
+    data = static_cast<const char*>(mapped);
+    return true;
+}
@@ -0,0 +1,81 @@
+#ifndef LAZY_H
+#define LAZY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "parser.h"
+#include "error_handler.h"
+
+// Отложенный разбор для однократного выполнения. Предварительный проход
+// по тексту находит заголовки case внешнего switch (значение и начало),
+// не строя токенов и узлов; полностью разбирается и проверяется только
+// тело, которое будет выполнено. Включается явно (--lazy): по умолчанию
+// программа разбирается и проверяется целиком.
+
+// Заголовок case: значение и смещение ключевого слова case в тексте
+struct CaseHeader {
+    int32_t key;
+    size_t begin;
+};
+
+class CaseIndex {
+public:
+    // Построение индекса. false — структура не распознана (ошибка разбора
+    // или необычная запись); тогда нужен полный разбор, который и выдаст
+    // точную диагностику.
+    bool build(std::string_view text);
+    
+    const std::string& variable() const { return variableName; }
+    // Переменные всех switch программы в порядке первого появления,
+    // как в CompiledProgram::variables после полного разбора
+    const std::vector<std::string>& variables() const { return switchVariables; }
+    size_t caseCount() const { return cases.size(); }
+    
+    // AST из внешнего switch с выполняемыми телами: первым case с данным
+    // значением (и следующими за ним до break) или default. Ошибки
+    // фрагмента — в errors.
+    std::unique_ptr<ASTNode> parseSelected(int32_t value, ErrorHandler& errors) const;
+
+private:
+    std::string_view text;
+    std::string variableName;
+    std::vector<std::string> switchVariables;
+    size_t variableOffset = 0;
+    std::vector<CaseHeader> cases;
+    size_t defaultBegin = 0;
+    size_t switchEnd = 0;  // закрывающая '}' внешнего switch
+    
+    // Уже просмотренная часть текста: смещения в parseSelected растут,
+    // поэтому строки считаются от предыдущего смещения, а не от начала
+    struct Cursor {
+        size_t offset = 0;
+        size_t line = 1;
+        size_t lineStart = 0;
+    };
+    
+    // Строка и колонка смещения (для диагностики во фрагменте)
+    void location(size_t offset, Cursor& cursor, size_t& line, size_t& column) const;
+};
+
+// Файл, отображенный в память только для чтения
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    bool open(const std::string& filename);
+    std::string_view text() const { return std::string_view(data, size); }
+
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+};
+
+#endif // LAZY_H
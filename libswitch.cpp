@@ -0,0 +1,153 @@
+#include "libswitch.h"
+#include "scanner.h"
+#include "parser.h"
+#include "semantic.h"
+#include "error_handler.h"
+#include "trace.h"
+#include <cstring>
+
+using namespace std;
+
+// Получатели событий вычисления: выводятся только строки print
+struct BufferSink {
+    char* buffer;
+    size_t capacity;
+    size_t size = 0;
+    
+    void onCase(const CompiledProgram&, const CompiledSwitch&, uint32_t, int) {}
+    void onDefault(const CompiledProgram&, const CompiledSwitch&, int) {}
+    void onNoMatch(const CompiledProgram&, const CompiledSwitch&, int) {}
+    
+    void onOutput(string_view text, int) {
+        append(text.data(), text.size());
+        append("\n", 1);
+    }
+    
+    void append(const char* data, size_t length) {
+        if (size < capacity) {
+            memcpy(buffer + size, data, min(length, capacity - size));
+        }
+        size += length;
+    }
+};
+
+struct CallbackSink {
+    SwitchOutputCallback callback;
+    void* context;
+    
+    void onCase(const CompiledProgram&, const CompiledSwitch&, uint32_t, int) {}
+    void onDefault(const CompiledProgram&, const CompiledSwitch&, int) {}
+    void onNoMatch(const CompiledProgram&, const CompiledSwitch&, int) {}
+    
+    void onOutput(string_view text, int) {
+        callback(text.data(), text.size(), context);
+    }
+};
+
+// Набор значений для вычисления по одному значению I без выделения памяти
+// для типичного числа переменных
+template <typename F>
+static void withValueTuple(const CompiledProgram& program, int valueSlot, int value, F&& f) {
+    const size_t inlineCount = 16;
+    size_t count = program.variables.size();
+    
+    int32_t inlineValues[inlineCount];
+    vector<int32_t> heapValues;
+    int32_t* values = inlineValues;
+    if (count > inlineCount) {
+        heapValues.resize(count);
+        values = heapValues.data();
+    }
+    
+    fill(values, values + count, SemanticAnalyzer::DEFAULT_VALUE);
+    if (valueSlot >= 0) values[valueSlot] = value;
+    f(values);
+}
+
+SwitchProgram::SwitchProgram(CompiledProgram&& compiledProgram)
+    : program(make_unique<CompiledProgram>(move(compiledProgram))),
+      valueSlot(program->variableIndex("I")) {}
+
+SwitchProgram::~SwitchProgram() = default;
+
+const vector<string>& SwitchProgram::variables() const {
+    return program->variables;
+}
+
+unique_ptr<SwitchProgram> SwitchProgram::compile(const char* source, size_t length,
+                                                 vector<SwitchDiagnostic>& diagnostics) {
+    // Этапы разбора и анализа размечены для --trace самого транслятора;
+    // встраивающий процесс трассировку не заказывал
+    TracePause pause;
+    
+    ErrorHandler errors;
+    Scanner scanner(string(source, length));
+    Parser parser(scanner, errors);
+    auto ast = parser.parse();
+    
+    SemanticAnalyzer semantic(errors);
+    if (!errors.hasErrors()) {
+        semantic.analyze(ast);
+    }
+    
+    if (errors.hasErrors()) {
+        for (const Error& error : errors.getErrors()) {
+            diagnostics.push_back({error.message, error.line, error.column});
+        }
+        return nullptr;
+    }
+    
+    return unique_ptr<SwitchProgram>(new SwitchProgram(semantic.takeProgram()));
+}
+
+size_t SwitchProgram::evaluate(int value, char* buffer, size_t capacity) const {
+    size_t size = 0;
+    withValueTuple(*program, valueSlot, value, [&](const int32_t* values) {
+        size = evaluate(values, buffer, capacity);
+    });
+    return size;
+}
+
+void SwitchProgram::evaluate(int value, SwitchOutputCallback callback, void* context) const {
+    withValueTuple(*program, valueSlot, value, [&](const int32_t* values) {
+        evaluate(values, callback, context);
+    });
+}
+
+size_t SwitchProgram::evaluate(const int32_t* values, char* buffer, size_t capacity) const {
+    BufferSink sink{buffer, capacity};
+    program->evaluate(values, sink);
+    return sink.size;
+}
+
+void SwitchProgram::evaluate(const int32_t* values, SwitchOutputCallback callback, void* context) const {
+    CallbackSink sink{callback, context};
+    program->evaluate(values, sink);
+}
+
+// Вычисление с разбивкой времени на поиск case и вывод
+template <typename Sink>
+static void evaluateTimed(const CompiledProgram& program, const int32_t* values, Sink& sink,
+                          SwitchTiming& timing) {
+    uint64_t begin = Latency::now();
+    LatencySample sample(begin);
+    program.evaluate(values, sink, &sample);
+    uint64_t end = Latency::now();
+    sample.finish(end);
+    timing.total = end - begin;
+    timing.lookup = sample.lookup;
+    timing.emit = sample.emit;
+}
+
+size_t SwitchProgram::evaluate(const int32_t* values, char* buffer, size_t capacity,
+                               SwitchTiming& timing) const {
+    BufferSink sink{buffer, capacity};
+    evaluateTimed(*program, values, sink, timing);
+    return sink.size;
+}
+
+void SwitchProgram::evaluate(const int32_t* values, SwitchOutputCallback callback, void* context,
+                             SwitchTiming& timing) const {
+    CallbackSink sink{callback, context};
+    evaluateTimed(*program, values, sink, timing);
+}
@@ -0,0 +1,76 @@
+#ifndef LIBSWITCH_H
+#define LIBSWITCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Внутреннее представление программы (compiler.h)
+struct CompiledProgram;
+
+// Встраиваемый интерфейс транслятора (libswitch.a).
+// Не использует потоки ввода-вывода и общий ErrorHandler: каждая компиляция
+// работает со своими объектами, поэтому compile() можно вызывать
+// из нескольких потоков одновременно. Скомпилированная программа неизменяема,
+// и evaluate() для одной программы тоже безопасен из любого числа потоков.
+// Вычисление не зависит от глобальных настроек процесса (--latency,
+// --trace): время измеряется только по запросу, вызовом с SwitchTiming,
+// а компиляция не записывает интервалы в трассировку процесса.
+
+// Диагностика компиляции
+struct SwitchDiagnostic {
+    std::string message;
+    int line;
+    int column;
+};
+
+// Время одного вычисления, нс
+struct SwitchTiming {
+    uint64_t total = 0;   // вычисление целиком
+    uint64_t lookup = 0;  // выбор case (сумма по вложенным switch)
+    uint64_t emit = 0;    // передача вывода в буфер или callback
+};
+
+// Получатель вывода: вызывается для каждой строки print
+using SwitchOutputCallback = void (*)(const char* text, size_t length, void* context);
+
+class SwitchProgram {
+public:
+    // Компиляция текста программы. При ошибках возвращает nullptr,
+    // а диагностика (в порядке обнаружения) записывается в diagnostics.
+    static std::unique_ptr<SwitchProgram> compile(const char* source, size_t length,
+                                                  std::vector<SwitchDiagnostic>& diagnostics);
+    
+    // Вычисление для значения I (остальные переменные равны 1).
+    // Строки print записываются в buffer через '\n' без завершающего нуля;
+    // возвращается полный размер вывода, даже если он не поместился.
+    size_t evaluate(int value, char* buffer, size_t capacity) const;
+    void evaluate(int value, SwitchOutputCallback callback, void* context) const;
+    
+    // Вычисление для набора значений: values[i] — значение variables()[i]
+    size_t evaluate(const int32_t* values, char* buffer, size_t capacity) const;
+    void evaluate(const int32_t* values, SwitchOutputCallback callback, void* context) const;
+    
+    // То же с измерением времени вычисления в timing
+    size_t evaluate(const int32_t* values, char* buffer, size_t capacity, SwitchTiming& timing) const;
+    void evaluate(const int32_t* values, SwitchOutputCallback callback, void* context,
+                  SwitchTiming& timing) const;
+    
+    ~SwitchProgram();
+    
+    const std::vector<std::string>& variables() const;
+    
+    // Для средств самого транслятора (образ программы, бенчмарк);
+    // определение типа — во внутреннем compiler.h
+    const CompiledProgram& compiled() const { return *program; }
+
+private:
+    explicit SwitchProgram(CompiledProgram&& program);
+    
+    std::unique_ptr<CompiledProgram> program;
+    int valueSlot; // индекс I в variables() или -1
+};
+
+#endif // LIBSWITCH_H
@@ -2,96 +2,131 @@
 #include <fstream>
 #include <string>
 #include <memory>
+#include <vector>
+#include <cerrno>
+#include <unistd.h>
 #include "scanner.h"
 #include "parser.h"
 #include "semantic.h"
+#include "profile.h"
+#include "watch.h"
+#include "repl.h"
+#include "workers.h"
+#include "batch.h"
+#include "lazy.h"
+#include "trace.h"
+#include "latency.h"
 #include "error_handler.h"
 
 using namespace std;
 
+// Параметры запуска из командной строки
+struct Options {
+    int switchValue = 1;
+    VariableValues values;  // значения переменных из -v ИМЯ=N
+    bool showAST = false;
+    bool showSymbols = false;
+    string profileIn;   // профиль для упорядочивания выбора case
+    string profileOut;  // файл, в который накапливаются попадания
+    string traceOut;    // файл трассировки в формате Chrome trace-event
+    unsigned workers = 0; // число процессов-вычислителей (--workers)
+    bool lazy = false;    // разбор только выполняемого тела (--lazy)
+    size_t maxErrors = 0; // лимит ошибок (--max-errors, 0 — без ограничения)
+    bool latency = false; // гистограммы задержек вычислений (--latency)
+};
+
+// Профиль, загруженный из --profile-in, и попадания для --profile-out
+static CaseProfile inputProfile;
+static CaseProfile recordedProfile;
+
+static void configureProfiling(SemanticAnalyzer& semantic, const Options& options) {
+    if (!options.profileIn.empty()) {
+        semantic.setProfile(&inputProfile);
+    }
+    if (!options.profileOut.empty()) {
+        semantic.enableProfiling();
+    }
+}
+
+static void collectProfile(const SemanticAnalyzer& semantic, const Options& options) {
+    if (!options.profileOut.empty()) {
+        semantic.exportProfile(recordedProfile);
+    }
+}
+
 void printHelp() {
     cout << "Использование:\n";
-    cout << "  switch_translator [опции] [файл]\n\n";
+    cout << "  switch_translator [опции] [файл...]\n";
+    cout << "  Если файл равен '-' или stdin не является терминалом,\n";
+    cout << "  программы читаются из stdin в потоковом режиме.\n\n";
     cout << "Опции:\n";
     cout << "  -h, --help       Показать эту справку\n";
     cout << "  -i, --interactive Интерактивный режим\n";
     cout << "  -v, --value N    Установить значение переменной I (по умолчанию: 1)\n";
+    cout << "  -v, --value X=N  Установить значение переменной X (по умолчанию: 1)\n";
     cout << "  -a, --ast        Показать AST\n";
     cout << "  -s, --symbols    Показать таблицу символов\n";
+    cout << "  --profile-out F  Накопить в файле F число попаданий в каждый case\n";
+    cout << "  --profile-in F   Упорядочить выбор case по профилю из файла F\n";
+    cout << "  --lazy           Разбирать и проверять только выполняемый case\n";
+    cout << "  --strict         Разбирать и проверять все case (по умолчанию, отменяет --lazy)\n";
+    cout << "  --max-errors N   Остановить разбор после N ошибок (0 — без ограничения)\n";
+    cout << "  --trace F        Записать трассировку этапов в F (Chrome trace-event)\n";
+    cout << "  --latency        Вывести в stderr процентили задержек вычислений,\n";
+    cout << "                   поиска case и вывода при выходе и по SIGUSR1\n";
+    cout << "  --workers N      Вычислять запросы из stdin в N процессах\n";
+    cout << "                   по общему образу программы\n";
+    cout << "  --watch          Следить за файлами и каталогами и пересобирать их\n";
+    cout << "                   при каждом сохранении\n";
 }
 
-void runInteractiveMode() {
-    cout << "=== ИНТЕРАКТИВНЫЙ РЕЖИМ ===" << endl;
-    cout << "Введите оператор switch (Ctrl+D для завершения):\n\n";
+// Однократное выполнение без полного разбора: индекс заголовков case
+// и разбор одного выполняемого тела. false — индекс не построен,
+// нужен полный разбор.
+static bool processTextLazily(string_view text, const Options& options) {
+    CaseIndex index;
+    if (!index.build(text)) {
+        return false;
+    }
     
-    string input;
-    string line;
+    // Значение внешней переменной выбирается так же, как при выполнении
+    auto it = options.values.find(index.variable());
+    int value = it != options.values.end() ? it->second
+              : index.variable() == "I" ? options.switchValue : SemanticAnalyzer::DEFAULT_VALUE;
     
-    while (true) {
-        cout << "> ";
-        if (!getline(cin, line)) {
-            break;
-        }
-        
-        if (line == "exit" || line == "quit") {
-            break;
-        }
-        
-        input += line + "\n";
-        
-        // Проверяем, завершен ли оператор switch
-        if (line.find('}') != string::npos) {
-            // Очищаем предыдущие ошибки
-            ErrorHandler::getInstance().clear();
-            
-            Scanner scanner(input);
-            Parser parser(scanner);
-            
-            auto ast = parser.parse();
-            
-            if (ErrorHandler::getInstance().hasErrors()) {
-                ErrorHandler::getInstance().printErrors();
-            } else {
-                cout << "\n✓ Синтаксический анализ успешен\n";
-                
-                SemanticAnalyzer semantic;
-                semantic.analyze(ast);
-                
-                if (ErrorHandler::getInstance().hasErrors()) {
-                    ErrorHandler::getInstance().printErrors();
-                } else {
-                    cout << "✓ Семантический анализ успешен\n";
-                    
-                    // Запрашиваем значение для выполнения
-                    int switchValue;
-                    cout << "\nВведите значение переменной I: ";
-                    if (cin >> switchValue) {
-                        cin.ignore(); // Очищаем буфер
-                        semantic.execute(ast, switchValue);
-                    } else {
-                        cout << "Некорректное значение\n";
-                        cin.clear();
-                        cin.ignore(10000, '\n');
-                    }
-                }
-            }
-            
-            input.clear();
-            cout << endl;
-        }
-    }
-}
-
-void processFile(const string& filename, int switchValue, bool showAST, bool showSymbols) {
-    ifstream file(filename);
-    if (!file.is_open()) {
-        cerr << "Ошибка: не удалось открыть файл " << filename << endl;
-        return;
+    auto ast = index.parseSelected(value, ErrorHandler::getInstance());
+    if (ErrorHandler::getInstance().hasErrors()) {
+        ErrorHandler::getInstance().printErrors();
+        return true;
     }
     
-    cout << "=== ОБРАБОТКА ФАЙЛА: " << filename << " ===" << endl;
+    cout << "✓ Проиндексировано case: " << index.caseCount()
+         << ", разобрано только выполняемое тело (--lazy)\n";
     
-    Scanner scanner(file);
+    // Значения выводятся для всех переменных, как после полного разбора
+    SemanticAnalyzer semantic;
+    semantic.declareVariables(index.variables());
+    semantic.analyze(ast);
+    
+    if (ErrorHandler::getInstance().hasErrors()) {
+        ErrorHandler::getInstance().printErrors();
+        return true;
+    }
+    
+    cout << "✓ Семантический анализ успешен\n";
+    cout << "\n=== РЕЗУЛЬТАТ ВЫПОЛНЕНИЯ ===" << endl;
+    semantic.execute(ast, options.switchValue, options.values);
+    return true;
+}
+
+// AST, таблица символов и профиль нужны для всей программы
+static bool lazyAllowed(const Options& options) {
+    return options.lazy && !options.showAST && !options.showSymbols &&
+           options.profileIn.empty() && options.profileOut.empty();
+}
+
+// Полный разбор, анализ и выполнение программы
+static void translate(Scanner& scanner, const Options& options) {
     Parser parser(scanner);
     
     auto ast = parser.parse();
@@ -104,6 +139,7 @@ void processFile(const string& filename, int switchValue, bool showAST, bool sho
     cout << "✓ Синтаксический анализ успешен\n";
     
     SemanticAnalyzer semantic;
+    configureProfiling(semantic, options);
     semantic.analyze(ast);
     
     if (ErrorHandler::getInstance().hasErrors()) {
@@ -113,25 +149,133 @@ void processFile(const string& filename, int switchValue, bool showAST, bool sho
     
     cout << "✓ Семантический анализ успешен\n";
     
-    if (showAST) {
+    if (options.showAST) {
         cout << "\n=== АБСТРАКТНОЕ СИНТАКСИЧЕСКОЕ ДЕРЕВО ===" << endl;
         ast->print();
     }
     
-    if (showSymbols) {
+    if (options.showSymbols) {
         semantic.printSymbolTable();
     }
     
     cout << "\n=== РЕЗУЛЬТАТ ВЫПОЛНЕНИЯ ===" << endl;
-    semantic.execute(ast, switchValue);
+    semantic.execute(ast, options.switchValue, options.values);
+    collectProfile(semantic, options);
+}
+
+void processFile(const string& filename, const Options& options) {
+    // Для отложенного разбора файл отображается в память; если индекс
+    // не построен, полный разбор идет по тому же тексту
+    MappedFile mapped;
+    bool isMapped = lazyAllowed(options) && mapped.open(filename);
+    ifstream file;
+    if (!isMapped) {
+        file.open(filename);
+        if (!file.is_open()) {
+            cerr << "Ошибка: не удалось открыть файл " << filename << endl;
+            return;
+        }
+    }
+    
+    cout << "=== ОБРАБОТКА ФАЙЛА: " << filename << " ===" << endl;
+    ErrorHandler::getInstance().clear();
+    
+    if (isMapped) {
+        if (processTextLazily(mapped.text(), options)) return;
+        Scanner scanner(mapped.text());
+        translate(scanner, options);
+        return;
+    }
+    
+    Scanner scanner(file);
+    translate(scanner, options);
+}
+
+// Файл, прочитанный пакетно (BatchReader): текст уже в памяти
+static void processLoadedFile(const LoadedFile& file, const Options& options) {
+    if (file.error) {
+        cerr << "Ошибка: не удалось открыть файл " << file.path << endl;
+        return;
+    }
+    
+    cout << "=== ОБРАБОТКА ФАЙЛА: " << file.path << " ===" << endl;
+    ErrorHandler::getInstance().clear();
+    
+    if (lazyAllowed(options) && processTextLazily(file.text, options)) {
+        return;
+    }
+    
+    Scanner scanner(file.text);
+    translate(scanner, options);
+}
+
+// Чтение stdin порциями: read() возвращает данные, как только они пришли,
+// не дожидаясь заполнения всего буфера
+static size_t readStdinChunk(char* buffer, size_t capacity) {
+    ssize_t received;
+    do {
+        received = read(STDIN_FILENO, buffer, capacity);
+    } while (received < 0 && errno == EINTR);
+    return received > 0 ? static_cast<size_t>(received) : 0;
+}
+
+void processStream(const Options& options) {
+    // Текст разбирается по мере поступления, ошибки выводятся сразу,
+    // а каждый switch выполняется, как только прочитана его закрывающая '}'
+    Scanner scanner(readStdinChunk);
+    ErrorHandler& errors = ErrorHandler::getInstance();
+    errors.setImmediate(true);
+    
+    int programNumber = 0;
+    while (true) {
+        errors.clear();
+        
+        Parser parser(scanner);
+        if (parser.isAtEnd()) break;
+        
+        cout << "=== ПРОГРАММА " << ++programNumber << " ===" << endl;
+        auto ast = parser.parse();
+        
+        if (errors.hasErrors()) {
+            errors.printErrors();
+            continue;
+        }
+        
+        cout << "✓ Синтаксический анализ успешен\n";
+        
+        SemanticAnalyzer semantic;
+        configureProfiling(semantic, options);
+        semantic.analyze(ast);
+        
+        if (errors.hasErrors()) {
+            errors.printErrors();
+            continue;
+        }
+        
+        cout << "✓ Семантический анализ успешен\n";
+        
+        if (options.showAST) {
+            cout << "\n=== АБСТРАКТНОЕ СИНТАКСИЧЕСКОЕ ДЕРЕВО ===" << endl;
+            ast->print();
+        }
+        
+        if (options.showSymbols) {
+            semantic.printSymbolTable();
+        }
+        
+        semantic.execute(ast, options.switchValue, options.values);
+        collectProfile(semantic, options);
+        cout << endl;
+    }
+    
+    errors.setImmediate(false);
 }
 
 int main(int argc, char* argv[]) {
-    string filename;
-    int switchValue = 1;
+    vector<string> filenames;
+    Options options;
     bool interactive = false;
-    bool showAST = false;
-    bool showSymbols = false;
+    bool watch = false;
     
     // Парсинг аргументов командной строки
     for (int i = 1; i < argc; i++) {
@@ -145,7 +289,13 @@ int main(int argc, char* argv[]) {
         } else if (arg == "-v" || arg == "--value") {
             if (i + 1 < argc) {
                 try {
-                    switchValue = stoi(argv[++i]);
+                    string value = argv[++i];
+                    size_t equals = value.find('=');
+                    if (equals == string::npos) {
+                        options.switchValue = stoi(value);
+                    } else {
+                        options.values[value.substr(0, equals)] = stoi(value.substr(equals + 1));
+                    }
                 } catch (...) {
                     cerr << "Ошибка: некорректное значение для -v" << endl;
                     return 1;
@@ -155,11 +305,49 @@ int main(int argc, char* argv[]) {
                 return 1;
             }
         } else if (arg == "-a" || arg == "--ast") {
-            showAST = true;
+            options.showAST = true;
         } else if (arg == "-s" || arg == "--symbols") {
-            showSymbols = true;
-        } else if (arg[0] != '-') {
-            filename = arg;
+            options.showSymbols = true;
+        } else if (arg == "--profile-out" || arg == "--profile-in" || arg == "--trace") {
+            if (i + 1 >= argc) {
+                cerr << "Ошибка: отсутствует имя файла для " << arg << endl;
+                return 1;
+            }
+            string& target = arg == "--trace" ? options.traceOut
+                            : arg == "--profile-out" ? options.profileOut : options.profileIn;
+            target = argv[++i];
+        } else if (arg == "--workers") {
+            int count = 0;
+            try {
+                count = i + 1 < argc ? stoi(argv[++i]) : 0;
+            } catch (...) {
+            }
+            if (count <= 0) {
+                cerr << "Ошибка: некорректное число процессов для --workers" << endl;
+                return 1;
+            }
+            options.workers = static_cast<unsigned>(count);
+        } else if (arg == "--max-errors") {
+            int count = -1;
+            try {
+                count = i + 1 < argc ? stoi(argv[++i]) : -1;
+            } catch (...) {
+            }
+            if (count < 0) {
+                cerr << "Ошибка: некорректное число для --max-errors" << endl;
+                return 1;
+            }
+            options.maxErrors = static_cast<size_t>(count);
+        } else if (arg == "--lazy") {
+            options.lazy = true;
+        } else if (arg == "--strict") {
+            options.lazy = false;
+        } else if (arg == "--latency") {
+            options.latency = true;
+        } else if (arg == "--watch") {
+            watch = true;
+        } else if (arg[0] != '-' || arg == "-") {
+            filenames.push_back(arg);
         } else {
             cerr << "Неизвестный аргумент: " << arg << endl;
             printHelp();
@@ -167,10 +355,63 @@ int main(int argc, char* argv[]) {
         }
     }
     
-    if (interactive) {
-        runInteractiveMode();
-    } else if (!filename.empty()) {
-        processFile(filename, switchValue, showAST, showSymbols);
+    if (!options.profileIn.empty() && !inputProfile.load(options.profileIn)) {
+        cerr << "Ошибка: не удалось прочитать профиль " << options.profileIn << endl;
+        return 1;
+    }
+    
+    // Попадания накапливаются поверх уже записанного профиля
+    if (!options.profileOut.empty()) {
+        recordedProfile.load(options.profileOut);
+    }
+    
+    if (!options.traceOut.empty()) {
+        Trace::enable();
+    }
+    // До запуска потоков: SIGUSR1 должен быть заблокирован во всех
+    if (options.latency) {
+        Latency::enable();
+    }
+    ErrorHandler::getInstance().setMaxErrors(options.maxErrors);
+    
+    int status = 0;
+    if (watch) {
+        if (filenames.empty()) {
+            cerr << "Ошибка: для --watch нужно указать файлы или каталоги" << endl;
+            return 1;
+        }
+        WatchSession session(options.switchValue, options.values);
+        for (const string& path : filenames) {
+            session.addPath(path);
+        }
+        status = session.run();
+    } else if (options.workers) {
+        if (filenames.size() != 1) {
+            cerr << "Ошибка: для --workers нужно указать один файл" << endl;
+            return 1;
+        }
+        status = runWorkerPool(filenames[0], options.workers, options.switchValue, options.values,
+                               options.maxErrors);
+    } else if (interactive) {
+        ReplSession session(options.switchValue, options.values);
+        session.run(cin);
+    } else if ((filenames.size() == 1 && filenames[0] == "-") ||
+               (filenames.empty() && !isatty(STDIN_FILENO))) {
+        processStream(options);
+    } else if (!filenames.empty()) {
+        // Несколько файлов или каталог читаются пакетно, одновременно
+        // с трансляцией уже прочитанных
+        vector<string> files = expandPaths(filenames);
+        if (files.size() > 1) {
+            BatchReader reader;
+            reader.readAll(files, [&](const LoadedFile& file) {
+                processLoadedFile(file, options);
+            });
+        } else {
+            for (const string& filename : files) {
+                processFile(filename, options);
+            }
+        }
     } else {
         cout << "Введите оператор switch (пустая строка для завершения):\n\n";
         
@@ -197,6 +438,7 @@ int main(int argc, char* argv[]) {
                 cout << "\n✓ Синтаксический анализ успешен\n";
                 
                 SemanticAnalyzer semantic;
+                configureProfiling(semantic, options);
                 semantic.analyze(ast);
                 
                 if (ErrorHandler::getInstance().hasErrors()) {
@@ -205,16 +447,32 @@ int main(int argc, char* argv[]) {
                     cout << "✓ Семантический анализ успешен\n";
                     
                     cout << "\nВведите значение переменной I: ";
+                    int switchValue;
                     if (cin >> switchValue) {
                         semantic.execute(ast, switchValue);
                     } else {
                         cout << "Некорректное значение, используется значение по умолчанию: 1\n";
                         semantic.execute(ast, 1);
                     }
+                    collectProfile(semantic, options);
                 }
             }
         }
     }
     
-    return 0;
+    if (!options.profileOut.empty() && !recordedProfile.save(options.profileOut)) {
+        cerr << "Ошибка: не удалось записать профиль " << options.profileOut << endl;
+        return 1;
+    }
+    
+    if (!options.traceOut.empty() && !Trace::write(options.traceOut)) {
+        cerr << "Ошибка: не удалось записать трассировку " << options.traceOut << endl;
+        return 1;
+    }
+    
+    if (options.latency) {
+        Latency::write(cerr);
+    }
+    
+    return status;
 }
\ No newline at end of file
@@ -1,47 +1,68 @@
 #include "parser.h"
 #include "error_handler.h"
+#include "trace.h"
 #include <iostream>
 #include <iomanip>
+#include <charconv>
 
 using namespace std;
 
-void SwitchNode::print(int indent) const {
-    cout << string(indent, ' ') << "SWITCH (I) {" << endl;
-    for (const auto& caseNode : cases) {
-        caseNode->print(indent + 2);
+// Печать AST через visitNode()
+struct ASTPrinter {
+    int indent;
+    
+    void operator()(const SwitchNode& node) const {
+        cout << string(indent, ' ') << "SWITCH (" << node.variable.lexeme << ") {" << endl;
+        for (const auto& caseNode : node.cases) {
+            caseNode->print(indent + 2);
+        }
+        if (node.defaultCase) {
+            node.defaultCase->print(indent + 2);
+        }
+        cout << string(indent, ' ') << "}" << endl;
     }
-    if (defaultCase) {
-        defaultCase->print(indent + 2);
+    
+    void operator()(const CaseNode& node) const {
+        cout << string(indent, ' ') << "CASE " << node.value.lexeme << ":" << endl;
+        for (const auto& action : node.actions) {
+            action->print(indent + 2);
+        }
+        if (node.hasBreak) {
+            cout << string(indent, ' ') << "BREAK;" << endl;
+        }
     }
-    cout << string(indent, ' ') << "}" << endl;
-}
-
-void CaseNode::print(int indent) const {
-    cout << string(indent, ' ') << "CASE " << value.lexeme << ":" << endl;
-    for (const auto& action : actions) {
-        action->print(indent + 2);
+    
+    void operator()(const DefaultNode& node) const {
+        cout << string(indent, ' ') << "DEFAULT:" << endl;
+        for (const auto& action : node.actions) {
+            action->print(indent + 2);
+        }
     }
-    cout << string(indent, ' ') << "BREAK;" << endl;
-}
-
-void DefaultNode::print(int indent) const {
-    cout << string(indent, ' ') << "DEFAULT:" << endl;
-    for (const auto& action : actions) {
-        action->print(indent + 2);
+    
+    void operator()(const PrintNode& node) const {
+        cout << string(indent, ' ') << "print(\"" << node.text.lexeme << "\");" << endl;
     }
-}
+};
 
-void PrintNode::print(int indent) const {
-    cout << string(indent, ' ') << "print(\"" << text.lexeme << "\");" << endl;
+void ASTNode::print(int indent) const {
+    visitNode(*this, ASTPrinter{indent});
 }
 
-Parser::Parser(Scanner& scanner) : scanner(scanner) {
+Parser::Parser(Scanner& scanner, ErrorHandler& errors) : scanner(scanner), errors(errors) {
     advance();
 }
 
 void Parser::advance() {
     previousToken = currentToken;
-    currentToken = scanner.getNextToken();
+    if (Trace::enabled()) {
+        // Сканер работает по запросу парсера, поэтому его время суммируется
+        // и записывается аргументом интервала parse
+        uint64_t begin = Trace::now();
+        currentToken = scanner.getNextToken();
+        scanNanoseconds += Trace::now() - begin;
+    } else {
+        currentToken = scanner.getNextToken();
+    }
 }
 
 bool Parser::match(TokenType type) {
@@ -59,16 +80,41 @@ bool Parser::check(TokenType type) const {
 Token Parser::consume(TokenType type, const string& errorMessage) {
     if (check(type)) {
         Token token = currentToken;
+        panicMode = false;
         advance();
         return token;
     }
     
-    ErrorHandler::getInstance().addError(currentToken, errorMessage);
-    synchronize();
+    if (!panicMode) {
+        // Ошибка сканера (незавершенная строка, неизвестный символ)
+        // точнее ожидания парсера
+        errors.addError(currentToken, check(TokenType::ERROR) ? currentToken.lexeme : errorMessage);
+        synchronize();
+    }
     return Token(type, "", currentToken.line, currentToken.column);
 }
 
 void Parser::synchronize() {
+    panicMode = true;
+    
+    // Лимит ошибок исчерпан: остаток текста не разбирается
+    if (errors.limitReached() && scanner.skipToEnd()) {
+        advance();
+        return;
+    }
+    
+    // Восстановление на ближайшем case, default или '}' по индексу
+    // позиций сканера, без разбора пропускаемого текста на токены
+    if (check(TokenType::CASE) || check(TokenType::DEFAULT) ||
+        check(TokenType::RIGHT_BRACE) || check(TokenType::END_OF_FILE)) {
+        return;
+    }
+    if (scanner.skipToRecoveryPoint()) {
+        advance();
+        return;
+    }
+    
+    // Потоковый режим: текст известен не целиком, поиск по токенам
     while (!check(TokenType::END_OF_FILE)) {
         if (previousToken.type == TokenType::SEMICOLON) return;
         
@@ -87,7 +133,52 @@ void Parser::synchronize() {
 }
 
 unique_ptr<ASTNode> Parser::parse() {
-    return parseProgram();
+    TraceScope scope("parse");
+    auto ast = parseProgram();
+    scope.setArg("scan_ns", scanNanoseconds);
+    return ast;
+}
+
+bool Parser::isAtEnd() const {
+    return check(TokenType::END_OF_FILE);
+}
+
+unique_ptr<CaseNode> Parser::parseCaseClause() {
+    // Case разбирается как часть внешнего switch: вложенные switch
+    // в его действиях пропускают свою закрывающую '}' как обычно
+    switchDepth = 1;
+    auto caseNode = parseCase();
+    switchDepth = 0;
+    
+    if (!isAtEnd()) {
+        errors.addError(currentToken, "Ожидается конец case");
+    }
+    return caseNode;
+}
+
+vector<unique_ptr<CaseNode>> Parser::parseCaseClauses() {
+    vector<unique_ptr<CaseNode>> clauses;
+    switchDepth = 1;
+    do {
+        clauses.push_back(parseCase());
+    } while (check(TokenType::CASE));
+    switchDepth = 0;
+    
+    if (!isAtEnd()) {
+        errors.addError(currentToken, "Ожидается конец case");
+    }
+    return clauses;
+}
+
+unique_ptr<DefaultNode> Parser::parseDefaultClause() {
+    switchDepth = 1;
+    auto defaultNode = parseDefault();
+    switchDepth = 0;
+    
+    if (!isAtEnd()) {
+        errors.addError(currentToken, "Ожидается '}' в конце оператора switch");
+    }
+    return defaultNode;
 }
 
 unique_ptr<ASTNode> Parser::parseProgram() {
@@ -96,21 +187,17 @@ unique_ptr<ASTNode> Parser::parseProgram() {
 }
 
 unique_ptr<SwitchNode> Parser::parseOperator() {
-    // <Оператор> ::= SWITCH (I) {<СписокКейсов> <ПоУмолчанию>}
+    // <Оператор> ::= SWITCH (<Переменная>) {<СписокКейсов> <ПоУмолчанию>}
     auto switchNode = make_unique<SwitchNode>();
+    switchDepth++;
     
     consume(TokenType::SWITCH, "Ожидается ключевое слово 'switch'");
     consume(TokenType::LEFT_PAREN, "Ожидается '(' после 'switch'");
     
-    Token varToken = consume(TokenType::IDENTIFIER, "Ожидается переменная 'I'");
-    if (varToken.lexeme != "I") {
-        ErrorHandler::getInstance().addError(varToken, 
-            "Ожидается переменная 'I', получено: " + varToken.lexeme);
-    }
-    switchNode->variable = varToken;
+    switchNode->variable = consume(TokenType::IDENTIFIER, "Ожидается имя переменной");
     
     consume(TokenType::RIGHT_PAREN, "Ожидается ')' после переменной");
-    consume(TokenType::LEFT_BRACE, "Ожидается '{' после switch(I)");
+    consume(TokenType::LEFT_BRACE, "Ожидается '{' после switch(...)");
     
     // Парсим список case
     switchNode->cases = parseCaseList();
@@ -118,8 +205,16 @@ unique_ptr<SwitchNode> Parser::parseOperator() {
     // Парсим default
     switchNode->defaultCase = parseDefault();
     
-    consume(TokenType::RIGHT_BRACE, "Ожидается '}' в конце оператора switch");
+    // Закрывающую '}' внешнего switch не пропускаем через advance(): при
+    // потоковом вводе чтение следующего токена задержало бы выполнение
+    // до прихода новых данных
+    if (switchDepth == 1 && check(TokenType::RIGHT_BRACE)) {
+        previousToken = currentToken;
+    } else {
+        consume(TokenType::RIGHT_BRACE, "Ожидается '}' в конце оператора switch");
+    }
     
+    switchDepth--;
     return switchNode;
 }
 
@@ -135,19 +230,29 @@ vector<unique_ptr<ASTNode>> Parser::parseCaseList() {
 }
 
 unique_ptr<CaseNode> Parser::parseCase() {
-    // <Кейс> ::= CASE I : <СписокДействий> BREAK ;
+    // <Кейс> ::= CASE I : <СписокДействий> BREAK ; | CASE I : <СписокДействий>
     auto caseNode = make_unique<CaseNode>();
     
     consume(TokenType::CASE, "Ожидается ключевое слово 'case'");
     
     caseNode->value = consume(TokenType::NUMBER, "Ожидается число после 'case'");
+    
+    // Значение метки переводится в число один раз; анализатор и компилятор
+    // используют готовое caseNode->key
+    const string& digits = caseNode->value.lexeme;
+    auto result = from_chars(digits.data(), digits.data() + digits.size(), caseNode->key);
+    caseNode->hasKey = !digits.empty() && result.ec == errc() &&
+                       result.ptr == digits.data() + digits.size();
     consume(TokenType::COLON, "Ожидается ':' после номера case");
     
     // Парсим список действий
     caseNode->actions = parseActionList();
     
-    consume(TokenType::BREAK, "Ожидается 'break' в конце case");
-    consume(TokenType::SEMICOLON, "Ожидается ';' после 'break'");
+    // Без break тело проваливается в следующий case или default
+    caseNode->hasBreak = match(TokenType::BREAK);
+    if (caseNode->hasBreak) {
+        consume(TokenType::SEMICOLON, "Ожидается ';' после 'break'");
+    }
     
     return caseNode;
 }
@@ -169,15 +274,50 @@ vector<unique_ptr<ASTNode>> Parser::parseActionList() {
     // <СписокДействий> ::= <СписокДействий> <Действие> | <Действие>
     vector<unique_ptr<ASTNode>> actions;
     
-    while (check(TokenType::PRINT)) {
+    while (check(TokenType::PRINT) || check(TokenType::SWITCH)) {
         actions.push_back(parseAction());
     }
     
     return actions;
 }
 
-unique_ptr<PrintNode> Parser::parseAction() {
-    // <Действие> ::= print ( "Текст" ) ;
+unique_ptr<ASTNode> Parser::parseAction() {
+    // <Действие> ::= print ( "Текст" ) ; | <Оператор>
+    if (check(TokenType::SWITCH)) {
+        if (switchDepth >= MAX_SWITCH_DEPTH) {
+            return skipNestedSwitch();
+        }
+        return parseOperator();
+    }
+    return parsePrint();
+}
+
+unique_ptr<SwitchNode> Parser::skipNestedSwitch() {
+    // Рекурсивный спуск (и обходы AST после него) ограничен по глубине:
+    // слишком глубокий switch пропускается до парной '}' без построения узлов
+    if (!panicMode) {
+        errors.addError(currentToken, "Слишком глубокая вложенность switch (больше " +
+                        to_string(MAX_SWITCH_DEPTH) + ")");
+    }
+    panicMode = true;
+    
+    size_t depth = 0;
+    advance(); // switch
+    while (!check(TokenType::END_OF_FILE)) {
+        if (check(TokenType::LEFT_BRACE)) {
+            depth++;
+        } else if (check(TokenType::RIGHT_BRACE)) {
+            if (depth == 0) break; // '}' охватывающего switch
+            advance();
+            if (--depth == 0) break;
+            continue;
+        }
+        advance();
+    }
+    return make_unique<SwitchNode>();
+}
+
+unique_ptr<PrintNode> Parser::parsePrint() {
     auto printNode = make_unique<PrintNode>();
     
     consume(TokenType::PRINT, "Ожидается 'print'");
@@ -189,4 +329,4 @@ unique_ptr<PrintNode> Parser::parseAction() {
     consume(TokenType::SEMICOLON, "Ожидается ';' после print()");
     
     return printNode;
-}
\ No newline at end of file
+}
@@ -2,57 +2,132 @@
 #define PARSER_H
 
 #include "scanner.h"
+#include "error_handler.h"
+#include <cstdint>
 #include <vector>
 #include <memory>
 #include <string>
+#include <type_traits>
 
-// Абстрактный узел AST
+// Вид узла AST. Набор узлов закрыт: обход выполняется через visitNode()
+// по этому тегу, без виртуальной диспетчеризации и RTTI.
+enum class NodeKind {
+    SWITCH,
+    CASE,
+    DEFAULT,
+    PRINT
+};
+
+// Базовый узел AST
 struct ASTNode {
+    const NodeKind kind;
+    
+    explicit ASTNode(NodeKind k) : kind(k) {}
     virtual ~ASTNode() = default;
-    virtual void print(int indent = 0) const = 0;
+    
+    void print(int indent = 0) const;
 };
 
-// Узел для оператора switch
+// Узел для оператора switch (корень программы или действие внутри case)
 struct SwitchNode : public ASTNode {
+    static constexpr NodeKind KIND = NodeKind::SWITCH;
+    
     Token variable;
     std::vector<std::unique_ptr<ASTNode>> cases;
     std::unique_ptr<ASTNode> defaultCase;
     
-    void print(int indent = 0) const override;
+    SwitchNode() : ASTNode(KIND) {}
 };
 
 // Узел для case
 struct CaseNode : public ASTNode {
+    static constexpr NodeKind KIND = NodeKind::CASE;
+    
     Token value;
+    int32_t key = 0;       // значение метки, разобранное один раз при разборе
+    bool hasKey = false;   // метка — корректное число в диапазоне int32_t
     std::vector<std::unique_ptr<ASTNode>> actions;
+    // Без break выполнение продолжается телом следующего case или default.
+    // case без действий и без break — одна из меток группы case 1: case 2:
+    bool hasBreak = true;
     
-    void print(int indent = 0) const override;
+    CaseNode() : ASTNode(KIND) {}
 };
 
 // Узел для default
 struct DefaultNode : public ASTNode {
+    static constexpr NodeKind KIND = NodeKind::DEFAULT;
+    
     std::vector<std::unique_ptr<ASTNode>> actions;
     
-    void print(int indent = 0) const override;
+    DefaultNode() : ASTNode(KIND) {}
 };
 
 // Узел для оператора print
 struct PrintNode : public ASTNode {
+    static constexpr NodeKind KIND = NodeKind::PRINT;
+    
     Token text;
     
-    void print(int indent = 0) const override;
+    PrintNode() : ASTNode(KIND) {}
 };
 
+template <typename Node, typename Visitor>
+void dispatchNode(const ASTNode& node, Visitor& visitor) {
+    if constexpr (std::is_invocable_v<Visitor&, const Node&>) {
+        visitor(static_cast<const Node&>(node));
+    }
+}
+
+// Посетитель AST: вызывает перегрузку visitor для фактического типа узла.
+// Выбор перегрузки происходит на этапе компиляции; узлы, для которых
+// перегрузки нет, пропускаются.
+template <typename Visitor>
+void visitNode(const ASTNode& node, Visitor&& visitor) {
+    switch (node.kind) {
+        case NodeKind::SWITCH:  dispatchNode<SwitchNode>(node, visitor); break;
+        case NodeKind::CASE:    dispatchNode<CaseNode>(node, visitor); break;
+        case NodeKind::DEFAULT: dispatchNode<DefaultNode>(node, visitor); break;
+        case NodeKind::PRINT:   dispatchNode<PrintNode>(node, visitor); break;
+    }
+}
+
+// Набор перегруженных лямбд для visitNode()
+template <typename... Fs>
+struct Overloaded : Fs... {
+    using Fs::operator()...;
+};
+
+template <typename... Fs>
+Overloaded(Fs...) -> Overloaded<Fs...>;
+
 class Parser {
 public:
-    Parser(Scanner& scanner);
+    Parser(Scanner& scanner, ErrorHandler& errors = ErrorHandler::getInstance());
     
     std::unique_ptr<ASTNode> parse();
+    bool isAtEnd() const;
+    
+    // Разбор отдельного case или default вне switch
+    // (замена case в интерактивном режиме, разбор выполняемого тела)
+    std::unique_ptr<CaseNode> parseCaseClause();
+    std::unique_ptr<DefaultNode> parseDefaultClause();
+    // Несколько case подряд (группа меток с общим телом)
+    std::vector<std::unique_ptr<CaseNode>> parseCaseClauses();
+    
+    // Предельная вложенность switch: глубже разбор не спускается
+    static constexpr int MAX_SWITCH_DEPTH = 256;
     
 private:
     Scanner& scanner;
+    ErrorHandler& errors;
     Token currentToken;
     Token previousToken;
+    int switchDepth = 0; // вложенность разбираемого switch
+    // После ошибки и до первого успешно принятого токена новые ошибки
+    // не выводятся: одна поломка даёт одно сообщение
+    bool panicMode = false;
+    uint64_t scanNanoseconds = 0; // время сканера (только при трассировке)
     
     void advance();
     bool match(TokenType type);
@@ -61,14 +136,14 @@ private:
     
     // Функции разбора для каждого нетерминала
     /*
-    Грамматика (вариант 18):
+    Грамматика (вариант 18, с вложенными switch):
     <Программа> ::= <Оператор>
-    <Оператор> ::= SWITCH (I) {<СписокКейсов> <ПоУмолчанию>}
+    <Оператор> ::= SWITCH (<Переменная>) {<СписокКейсов> <ПоУмолчанию>}
     <СписокКейсов> ::= <СписокКейсов> <Кейс> | <Кейс>
-    <Кейс> ::= CASE I : <СписокДействий> BREAK ;
+    <Кейс> ::= CASE N : <СписокДействий> BREAK ; | CASE N : <СписокДействий>
     <ПоУмолчанию> ::= DEFAULT : <СписокДействий>
-    <СписокДействий> ::= <СписокДействий> <Действие> | <Действие>
-    <Действие> ::= print ( "Текст" ) ;
+    <СписокДействий> ::= <СписокДействий> <Действие> | <Действие> | ε
+    <Действие> ::= print ( "Текст" ) ; | <Оператор>
     */
     
     std::unique_ptr<ASTNode> parseProgram();
@@ -77,7 +152,9 @@ private:
     std::unique_ptr<CaseNode> parseCase();
     std::unique_ptr<DefaultNode> parseDefault();
     std::vector<std::unique_ptr<ASTNode>> parseActionList();
-    std::unique_ptr<PrintNode> parseAction();
+    std::unique_ptr<ASTNode> parseAction();
+    std::unique_ptr<PrintNode> parsePrint();
+    std::unique_ptr<SwitchNode> skipNestedSwitch();
     
     void synchronize();
 };
@@ -0,0 +1,85 @@
+#include "profile.h"
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <tuple>
+#include <algorithm>
+
+using namespace std;
+
+void CaseProfile::addCaseHits(const string& path, int32_t key, uint64_t hits) {
+    if (hits) switches[path].cases[key] += hits;
+}
+
+void CaseProfile::addDefaultHits(const string& path, uint64_t hits) {
+    if (hits) switches[path].defaultCount += hits;
+}
+
+uint64_t CaseProfile::caseHits(const string& path, int32_t key) const {
+    auto node = switches.find(path);
+    if (node == switches.end()) return 0;
+    auto it = node->second.cases.find(key);
+    return it != node->second.cases.end() ? it->second : 0;
+}
+
+uint64_t CaseProfile::defaultHits(const string& path) const {
+    auto node = switches.find(path);
+    return node != switches.end() ? node->second.defaultCount : 0;
+}
+
+bool CaseProfile::empty() const {
+    return switches.empty();
+}
+
+bool CaseProfile::load(const string& filename) {
+    ifstream file(filename);
+    if (!file.is_open()) return false;
+    
+    string line;
+    while (getline(file, line)) {
+        istringstream fields(line);
+        string kind;
+        string path;
+        fields >> kind >> path;
+        
+        if (kind == "case") {
+            int32_t key;
+            uint64_t hits;
+            if (fields >> key >> hits) addCaseHits(path, key, hits);
+        } else if (kind == "default") {
+            uint64_t hits;
+            if (fields >> hits) addDefaultHits(path, hits);
+        }
+    }
+    return true;
+}
+
+bool CaseProfile::save(const string& filename) const {
+    ofstream file(filename);
+    if (!file.is_open()) return false;
+    
+    // Самые горячие case первыми, чтобы файл было удобно читать
+    vector<tuple<string, int32_t, uint64_t>> entries;
+    for (const auto& node : switches) {
+        for (const auto& entry : node.second.cases) {
+            entries.emplace_back(node.first, entry.first, entry.second);
+        }
+    }
+    sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+        if (get<2>(a) != get<2>(b)) return get<2>(a) > get<2>(b);
+        return tie(get<0>(a), get<1>(a)) < tie(get<0>(b), get<1>(b));
+    });
+    
+    vector<string> paths;
+    for (const auto& node : switches) paths.push_back(node.first);
+    sort(paths.begin(), paths.end());
+    
+    file << "# switch_translator profile\n";
+    for (const auto& entry : entries) {
+        file << "case " << get<0>(entry) << " " << get<1>(entry) << " " << get<2>(entry) << "\n";
+    }
+    for (const auto& path : paths) {
+        file << "default " << path << " " << switches.at(path).defaultCount << "\n";
+    }
+    return static_cast<bool>(file);
+}
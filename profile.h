@@ -0,0 +1,39 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// Профиль выполнения: число попаданий в каждый case и в default.
+// Ключом служат путь к switch и значение case. Путь — переменные switch
+// от корня и метки, под которыми вложен switch: "I", "I/5/J",
+// "I/default/J"; второй switch по той же переменной в том же теле
+// получает суффикс "#2". Поэтому вложенные switch по одной переменной
+// считаются раздельно, а профиль переживает перекомпиляцию
+// и перестановку case в исходном тексте.
+class CaseProfile {
+public:
+    void addCaseHits(const std::string& path, int32_t key, uint64_t hits);
+    void addDefaultHits(const std::string& path, uint64_t hits);
+    
+    uint64_t caseHits(const std::string& path, int32_t key) const;
+    uint64_t defaultHits(const std::string& path) const;
+    bool empty() const;
+    
+    // Формат файла: строки "case <путь> <значение> <попадания>"
+    // и "default <путь> <попадания>". Путь корневого switch — имя его
+    // переменной, как в профилях, записанных до появления путей.
+    bool load(const std::string& filename);
+    bool save(const std::string& filename) const;
+
+private:
+    struct SwitchCounts {
+        std::unordered_map<int32_t, uint64_t> cases;
+        uint64_t defaultCount = 0;
+    };
+    
+    std::unordered_map<std::string, SwitchCounts> switches;
+};
+
+#endif // PROFILE_H
@@ -0,0 +1,365 @@
+#include "repl.h"
+#include "scanner.h"
+#include "error_handler.h"
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <unordered_set>
+
+using namespace std;
+
+// Получатель, отбрасывающий вывод: замер времени вычисления без терминала
+struct SilentSink {
+    size_t outputBytes = 0;
+    
+    void onCase(const CompiledProgram&, const CompiledSwitch&, uint32_t, int) {}
+    void onDefault(const CompiledProgram&, const CompiledSwitch&, int) {}
+    void onNoMatch(const CompiledProgram&, const CompiledSwitch&, int) {}
+    void onOutput(string_view text, int) { outputBytes += text.size(); }
+};
+
+static double elapsedMs(chrono::steady_clock::time_point begin) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+}
+
+// Баланс фигурных скобок вне строковых литералов
+static int braceBalance(const string& text) {
+    int balance = 0;
+    bool inString = false;
+    for (char c : text) {
+        if (c == '"') {
+            inString = !inString;
+        } else if (!inString && c == '{') {
+            balance++;
+        } else if (!inString && c == '}') {
+            balance--;
+        }
+    }
+    return balance;
+}
+
+static size_t countCases(const ASTNode& ast) {
+    size_t count = 0;
+    visitNode(ast, [&](const SwitchNode& node) { count = node.cases.size(); });
+    return count;
+}
+
+ReplSession::ReplSession(int value, const VariableValues& variableValues)
+    : switchValue(value), values(variableValues) {}
+
+ReplSession::ReplProgram* ReplSession::currentProgram() {
+    if (programs.empty()) {
+        cout << "Нет программ: введите switch или загрузите файл командой load" << endl;
+        return nullptr;
+    }
+    return &programs[current];
+}
+
+bool ReplSession::compileProgram(const string& source, const string& name) {
+    ErrorHandler errors;
+    auto begin = chrono::steady_clock::now();
+    
+    Scanner scanner(source);
+    Parser parser(scanner, errors);
+    auto ast = parser.parse();
+    double parseMs = elapsedMs(begin);
+    
+    if (errors.hasErrors()) {
+        errors.printErrors();
+        return false;
+    }
+    
+    begin = chrono::steady_clock::now();
+    auto semantic = make_unique<SemanticAnalyzer>(errors);
+    semantic->analyze(ast);
+    double analyzeMs = elapsedMs(begin);
+    
+    if (errors.hasErrors()) {
+        errors.printErrors();
+        return false;
+    }
+    
+    cout << "✓ Программа " << name << ": " << countCases(*ast) << " case, разбор "
+         << parseMs << " мс, анализ " << analyzeMs << " мс" << endl;
+    
+    programs.push_back(ReplProgram{name, move(ast), move(semantic)});
+    current = programs.size() - 1;
+    return true;
+}
+
+bool ReplSession::parseValues(istringstream& args, ValueSet& set) const {
+    set.values = values;
+    string word;
+    while (args >> word) {
+        try {
+            size_t equals = word.find('=');
+            size_t range = word.find("..");
+            if (equals != string::npos) {
+                set.values[word.substr(0, equals)] = stoi(word.substr(equals + 1));
+            } else if (range != string::npos) {
+                int first = stoi(word.substr(0, range));
+                int last = stoi(word.substr(range + 2));
+                if (last < first || static_cast<long long>(last) - first >= MAX_RANGE) {
+                    cout << "Некорректный диапазон " << word << endl;
+                    return false;
+                }
+                for (long long v = first; v <= last; v++) {
+                    set.switchValues.push_back(static_cast<int>(v));
+                }
+            } else {
+                set.switchValues.push_back(stoi(word));
+            }
+        } catch (...) {
+            cout << "Некорректное значение " << word << endl;
+            return false;
+        }
+    }
+    
+    if (set.switchValues.empty()) {
+        set.switchValues.push_back(switchValue);
+    }
+    return true;
+}
+
+void ReplSession::commandRun(istringstream& args) {
+    ReplProgram* program = currentProgram();
+    ValueSet set;
+    if (!program || !parseValues(args, set)) return;
+    
+    for (int value : set.switchValues) {
+        program->semantic->execute(program->ast, value, set.values);
+    }
+}
+
+void ReplSession::commandTime(istringstream& args) {
+    ReplProgram* program = currentProgram();
+    ValueSet set;
+    if (!program || !parseValues(args, set)) return;
+    
+    const CompiledProgram& compiled = program->semantic->getProgram();
+    vector<vector<int32_t>> tuples;
+    for (int value : set.switchValues) {
+        tuples.push_back(program->semantic->valueTuple(value, set.values));
+    }
+    
+    // Число повторов удваивается, пока замер не займет хотя бы 200 мс
+    SilentSink sink;
+    size_t evaluations = 0;
+    double ms = 0;
+    for (size_t batch = tuples.size(); ms < 200; batch *= 2) {
+        auto begin = chrono::steady_clock::now();
+        for (size_t i = 0; i < batch; i++) {
+            Latency::measure([&](LatencySample* sample) {
+                compiled.evaluate(tuples[i % tuples.size()].data(), sink, sample);
+            });
+        }
+        ms += elapsedMs(begin);
+        evaluations += batch;
+    }
+    
+    cout << evaluations << " вычислений за " << ms << " мс: "
+         << ms * 1e6 / evaluations << " нс/вычисление" << endl;
+}
+
+void ReplSession::commandCase(const string& text) {
+    ReplProgram* program = currentProgram();
+    if (!program) return;
+    
+    ErrorHandler errors;
+    Scanner scanner(text);
+    Parser parser(scanner, errors);
+    auto group = parser.parseCaseClauses();
+    if (errors.hasErrors()) {
+        errors.printErrors();
+        return;
+    }
+    unordered_set<int32_t> keys;
+    for (const auto& clause : group) {
+        if (!clause->hasKey) {
+            cout << "Некорректное значение case " << clause->value.lexeme << endl;
+            return;
+        }
+        keys.insert(clause->key);
+    }
+    
+    // Case с теми же значениями убираются, группа встает на место первого
+    // из них (или в конец). Старый список сохраняется, чтобы вернуть его,
+    // если программа с новыми case не пройдет проверку: origin — откуда
+    // взят каждый case нового списка (SIZE_MAX — из группы).
+    SwitchNode& root = static_cast<SwitchNode&>(*program->ast);
+    vector<unique_ptr<ASTNode>> previous = move(root.cases);
+    vector<size_t> origin;
+    root.cases.clear();
+    size_t replaced = 0;
+    auto insertGroup = [&] {
+        for (auto& clause : group) {
+            root.cases.push_back(move(clause));
+            origin.push_back(SIZE_MAX);
+        }
+    };
+    for (size_t i = 0; i < previous.size(); i++) {
+        if (keys.count(static_cast<const CaseNode&>(*previous[i]).key)) {
+            if (replaced++ == 0) insertGroup();
+            continue;
+        }
+        root.cases.push_back(move(previous[i]));
+        origin.push_back(i);
+    }
+    if (replaced == 0) insertGroup();
+    
+    auto begin = chrono::steady_clock::now();
+    auto semantic = make_unique<SemanticAnalyzer>(errors);
+    semantic->analyze(program->ast);
+    double analyzeMs = elapsedMs(begin);
+    
+    if (errors.hasErrors()) {
+        errors.printErrors();
+        for (size_t i = 0; i < root.cases.size(); i++) {
+            if (origin[i] != SIZE_MAX) previous[origin[i]] = move(root.cases[i]);
+        }
+        root.cases = move(previous);
+        cout << "Case не заменен" << endl;
+        return;
+    }
+    
+    program->semantic = move(semantic);
+    cout << "✓ Case " << (replaced ? "заменен" : "добавлен") << " в " << program->name
+         << ", анализ " << analyzeMs << " мс" << endl;
+}
+
+void ReplSession::commandList() const {
+    for (size_t i = 0; i < programs.size(); i++) {
+        const CompiledProgram& compiled = programs[i].semantic->getProgram();
+        cout << (i == current ? "* " : "  ") << programs[i].name << ": "
+             << countCases(*programs[i].ast) << " case, переменные:";
+        for (const string& name : compiled.variables) cout << " " << name;
+        cout << endl;
+    }
+}
+
+void ReplSession::commandUse(istringstream& args) {
+    string name;
+    args >> name;
+    for (size_t i = 0; i < programs.size(); i++) {
+        if (programs[i].name == name) {
+            current = i;
+            return;
+        }
+    }
+    cout << "Нет программы " << name << endl;
+}
+
+void ReplSession::commandLoad(istringstream& args) {
+    string filename;
+    args >> filename;
+    ifstream file(filename);
+    if (!file.is_open()) {
+        cout << "Ошибка: не удалось открыть файл " << filename << endl;
+        return;
+    }
+    string source((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    compileProgram(source, filename);
+}
+
+void ReplSession::printHelp() const {
+    cout << "Ввод switch (...) { ... } добавляет программу и делает ее текущей.\n";
+    cout << "Команды для текущей программы:\n";
+    cout << "  run [N | A..B | X=N]...  выполнить для значений I (и переменных X)\n";
+    cout << "  time [N | A..B | X=N]... замерить время вычисления без вывода\n";
+    cout << "  case N: ... break;       заменить или добавить case внешнего switch\n";
+    cout << "  case N: case M: ...      то же для группы меток; ввод без break\n";
+    cout << "                           завершается пустой строкой\n";
+    cout << "  ast                      показать AST\n";
+    cout << "  symbols                  показать таблицу символов\n";
+    cout << "Сеанс:\n";
+    cout << "  list                     список программ (* — текущая)\n";
+    cout << "  use ИМЯ                  сделать программу текущей\n";
+    cout << "  load ФАЙЛ                загрузить программу из файла\n";
+    cout << "  help, exit               справка, выход\n";
+}
+
+void ReplSession::execute(const string& line) {
+    istringstream args(line);
+    string command;
+    args >> command;
+    
+    if (command.empty()) {
+        return;
+    } else if (command == "run") {
+        commandRun(args);
+    } else if (command == "time") {
+        commandTime(args);
+    } else if (command == "case") {
+        commandCase(line);
+    } else if (command == "ast") {
+        if (ReplProgram* program = currentProgram()) program->ast->print();
+    } else if (command == "symbols") {
+        if (ReplProgram* program = currentProgram()) program->semantic->printSymbolTable();
+    } else if (command == "list") {
+        commandList();
+    } else if (command == "use") {
+        commandUse(args);
+    } else if (command == "load") {
+        commandLoad(args);
+    } else if (command == "help") {
+        printHelp();
+    } else {
+        cout << "Неизвестная команда " << command << " (help — список команд)" << endl;
+    }
+}
+
+void ReplSession::run(istream& input) {
+    cout << "=== ИНТЕРАКТИВНЫЙ РЕЖИМ ===" << endl;
+    printHelp();
+    cout << endl;
+    
+    // Многострочный ввод switch или case копится, пока скобки не закроются
+    string pending;
+    string line;
+    int programNumber = 0;
+    
+    while (true) {
+        cout << (pending.empty() ? "> " : "... ");
+        if (!getline(input, line)) {
+            break;
+        }
+        
+        if (pending.empty()) {
+            istringstream words(line);
+            string first;
+            words >> first;
+            if (first == "exit" || first == "quit") {
+                break;
+            }
+            if (first.compare(0, 6, "switch") != 0 && first != "case") {
+                execute(line);
+                continue;
+            }
+        }
+        
+        pending += line + "\n";
+        
+        // switch завершен, когда закрыта его первая '{'; case — когда
+        // после вложенных switch встретился break. Пустая строка
+        // завершает ввод досрочно (так вводится и case без break).
+        size_t start = pending.find_first_not_of(" \t");
+        bool isCase = pending.compare(start, 4, "case") == 0;
+        size_t lastBrace = pending.rfind('}');
+        bool ended = isCase ? pending.find("break", lastBrace == string::npos ? 0 : lastBrace) != string::npos
+                            : pending.find('{') != string::npos;
+        int balance = braceBalance(pending);
+        bool complete = balance < 0 || (balance == 0 && ended);
+        if (!complete && !line.empty()) {
+            continue;
+        }
+        
+        if (isCase) {
+            execute(pending);
+        } else {
+            compileProgram(pending, "p" + to_string(++programNumber));
+        }
+        pending.clear();
+    }
+    cout << endl;
+}
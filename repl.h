@@ -0,0 +1,56 @@
+#ifndef REPL_H
+#define REPL_H
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include "parser.h"
+#include "semantic.h"
+
+// Интерактивный режим. Сеанс хранит скомпилированные программы, поэтому
+// новые значения вычисляются без повторного ввода и разбора switch,
+// а отдельный case можно заменить, не вводя программу заново.
+class ReplSession {
+public:
+    ReplSession(int switchValue, const VariableValues& values);
+    
+    void run(std::istream& input);
+
+private:
+    struct ReplProgram {
+        std::string name;
+        std::unique_ptr<ASTNode> ast;
+        std::unique_ptr<SemanticAnalyzer> semantic;
+    };
+    
+    // Набор вычислений: значения I и общие значения остальных переменных
+    struct ValueSet {
+        std::vector<int> switchValues;
+        VariableValues values;
+    };
+    
+    // Значений I в одном диапазоне A..B не больше этого
+    static constexpr int MAX_RANGE = 1000000;
+    
+    std::vector<ReplProgram> programs;
+    size_t current = 0;
+    int switchValue;
+    VariableValues values;
+    
+    ReplProgram* currentProgram();
+    bool compileProgram(const std::string& source, const std::string& name);
+    void execute(const std::string& line);
+    bool parseValues(std::istringstream& args, ValueSet& set) const;
+    
+    void commandRun(std::istringstream& args);
+    void commandTime(std::istringstream& args);
+    void commandCase(const std::string& text);
+    void commandList() const;
+    void commandUse(std::istringstream& args);
+    void commandLoad(std::istringstream& args);
+    void printHelp() const;
+};
+
+#endif // REPL_H
@@ -1,6 +1,9 @@
 #include "scanner.h"
+#include "trace.h"
 #include <cctype>
 #include <unordered_map>
+#include <algorithm>
+#include <cstring>
 
 using namespace std;
 
@@ -13,16 +16,132 @@ static const unordered_map<string, TokenType> keywords = {
     {"print", TokenType::PRINT}
 };
 
-Scanner::Scanner(const string& input) 
-    : input(input), position(0), line(1), column(1), start(0) {}
+Scanner::Scanner(const string& text) 
+    : buffer(text), input(buffer), position(0), line(1), column(1), start(0), chunkSize(0) {}
 
-Scanner::Scanner(ifstream& file) : position(0), line(1), column(1), start(0) {
+Scanner::Scanner(string_view text)
+    : input(text), position(0), line(1), column(1), start(0), chunkSize(0) {}
+
+Scanner::Scanner(ifstream& file) : position(0), line(1), column(1), start(0), chunkSize(0) {
     // Чтение всего файла в строку
-    input = string((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    TRACE_SCOPE("read file");
+    buffer = string((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    input = buffer;
 }
 
+Scanner::Scanner(ChunkReader reader, size_t chunkSize)
+    : position(0), line(1), column(1), start(0),
+      reader(move(reader)), chunkSize(chunkSize) {}
+
 Scanner::~Scanner() {}
 
+void Scanner::setLocation(size_t startLine, size_t startColumn) {
+    line = startLine;
+    column = startColumn;
+}
+
+void Scanner::buildRecoveryIndex() {
+    TRACE_SCOPE("recovery index");
+    recoveryIndexed = true;
+    
+    // Строки и комментарии пропускаются целиком, чтобы case в тексте
+    // print не считался точкой восстановления
+    const char* text = input.data();
+    size_t size = input.size();
+    size_t i = position;
+    while (i < size) {
+        char c = text[i];
+        if (c == '"') {
+            size_t contentBegin = ++i;
+            while (true) {
+                const void* found = memchr(text + i, '"', size - i);
+                if (!found) return;
+                size_t quote = static_cast<const char*>(found) - text;
+                size_t slashes = quote;
+                while (slashes > contentBegin && text[slashes - 1] == '\\') slashes--;
+                i = quote + 1;
+                if ((quote - slashes) % 2 == 0) break;
+            }
+        } else if (c == '/' && i + 1 < size && text[i + 1] == '/') {
+            const void* found = memchr(text + i, '\n', size - i);
+            i = found ? static_cast<const char*>(found) - text + 1 : size;
+        } else if (c == '/' && i + 1 < size && text[i + 1] == '*') {
+            const char* end = static_cast<const char*>(memmem(text + i + 2, size - i - 2, "*/", 2));
+            if (!end) return;
+            i = end - text + 2;
+        } else if (c == '}') {
+            recoveryPoints.push_back(i++);
+        } else if (isalpha(static_cast<unsigned char>(c)) || c == '_') {
+            size_t begin = i;
+            while (i < size && (isalnum(static_cast<unsigned char>(text[i])) || text[i] == '_')) i++;
+            size_t length = i - begin;
+            if ((length == 4 && memcmp(text + begin, "case", 4) == 0) ||
+                (length == 7 && memcmp(text + begin, "default", 7) == 0)) {
+                recoveryPoints.push_back(begin);
+            }
+        } else {
+            i++;
+        }
+    }
+}
+
+void Scanner::moveTo(size_t target) {
+    // Строка и колонка пересчитываются по пропущенному тексту
+    const char* text = input.data();
+    size_t newlines = static_cast<size_t>(count(text + position, text + target, '\n'));
+    if (newlines) {
+        line += newlines;
+        const char* lastNewline = static_cast<const char*>(memrchr(text + position, '\n', target - position));
+        column = static_cast<size_t>(text + target - lastNewline);
+    } else {
+        column += target - position;
+    }
+    position = target;
+}
+
+bool Scanner::skipToRecoveryPoint() {
+    if (reader) return false;
+    if (!recoveryIndexed) buildRecoveryIndex();
+    
+    auto next = lower_bound(recoveryPoints.begin(), recoveryPoints.end(), position);
+    moveTo(next != recoveryPoints.end() ? *next : input.size());
+    return true;
+}
+
+bool Scanner::skipToEnd() {
+    if (reader) return false;
+    moveTo(input.size());
+    return true;
+}
+
+bool Scanner::refill() {
+    if (!reader) return false;
+    
+    TRACE_SCOPE("read chunk");
+    size_t oldSize = buffer.size();
+    buffer.resize(oldSize + chunkSize);
+    size_t received = reader(&buffer[oldSize], chunkSize);
+    buffer.resize(oldSize + received);
+    input = buffer;
+    
+    if (received == 0) {
+        reader = nullptr; // Ввод завершен
+        return false;
+    }
+    return true;
+}
+
+void Scanner::compact() {
+    // Лексемы копируются в токены, поэтому разобранный префикс не нужен.
+    // Сдвигаем буфер только когда префикс занимает его большую часть.
+    if (!reader || position == 0 || position < input.size() / 2) return;
+    
+    buffer.erase(0, position);
+    input = buffer;
+    position = 0;
+    start = 0;
+}
+
 char Scanner::advance() {
     if (isAtEnd()) return '\0';
     char c = input[position++];
@@ -35,58 +154,75 @@ char Scanner::advance() {
     return c;
 }
 
-char Scanner::peek() const {
+char Scanner::peek() {
     if (isAtEnd()) return '\0';
     return input[position];
 }
 
-bool Scanner::isAtEnd() const {
-    return position >= input.length();
+char Scanner::peekNext() {
+    while (position + 1 >= input.length()) {
+        if (!refill()) return '\0';
+    }
+    return input[position + 1];
 }
 
-void Scanner::skipWhitespace() {
+bool Scanner::isAtEnd() {
+    while (position >= input.length()) {
+        if (!refill()) return true;
+    }
+    return false;
+}
+
+bool Scanner::skipWhitespace() {
     while (!isAtEnd()) {
         char c = peek();
         if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
             advance();
-        } else if (c == '/') {
-            skipComment();
+        } else if (c == '/' && (peekNext() == '/' || peekNext() == '*')) {
+            if (!skipComment()) return false;
         } else {
+            // Одиночный '/' — не пробел: его разбирает getNextToken
             break;
         }
     }
+    return true;
 }
 
-void Scanner::skipComment() {
-    if (peek() == '/' && position + 1 < input.length() && input[position + 1] == '/') {
+bool Scanner::skipComment() {
+    if (peekNext() == '/') {
         // Однострочный комментарий
         while (!isAtEnd() && peek() != '\n') {
             advance();
         }
         if (!isAtEnd()) advance(); // Пропускаем \n
-    } else if (peek() == '/' && position + 1 < input.length() && input[position + 1] == '*') {
-        // Многострочный комментарий
-        advance(); // /
-        advance(); // *
-        while (!isAtEnd() && !(peek() == '*' && position + 1 < input.length() && input[position + 1] == '/')) {
-            advance();
-        }
-        if (!isAtEnd()) advance(); // *
-        if (!isAtEnd()) advance(); // /
+        return true;
+    }
+    
+    // Многострочный комментарий
+    tokenLine = line;
+    tokenColumn = column;
+    advance(); // /
+    advance(); // *
+    while (!isAtEnd() && !(peek() == '*' && peekNext() == '/')) {
+        advance();
     }
+    if (isAtEnd()) return false;
+    advance(); // *
+    advance(); // /
+    return true;
 }
 
 Token Scanner::makeToken(TokenType type) const {
-    string lexeme = input.substr(start, position - start);
-    return Token(type, lexeme, line, column - lexeme.length());
+    string lexeme(input.substr(start, position - start));
+    return Token(type, lexeme, tokenLine, tokenColumn);
 }
 
 Token Scanner::makeToken(TokenType type, const string& lexeme) const {
-    return Token(type, lexeme, line, column - lexeme.length());
+    return Token(type, lexeme, tokenLine, tokenColumn);
 }
 
 Token Scanner::errorToken(const string& message) const {
-    return Token(TokenType::ERROR, message, line, column);
+    return Token(TokenType::ERROR, message, tokenLine, tokenColumn);
 }
 
 Token Scanner::scanIdentifierOrKeyword() {
@@ -94,19 +230,15 @@ Token Scanner::scanIdentifierOrKeyword() {
         advance();
     }
     
-    string lexeme = input.substr(start, position - start);
+    string lexeme(input.substr(start, position - start));
     
     auto it = keywords.find(lexeme);
     if (it != keywords.end()) {
         return makeToken(it->second);
     }
     
-    // Проверяем, если это переменная I
-    if (lexeme == "I") {
-        return makeToken(TokenType::IDENTIFIER, lexeme);
-    }
-    
-    return errorToken("Недопустимый идентификатор: " + lexeme);
+    // Остальные идентификаторы — имена переменных
+    return makeToken(TokenType::IDENTIFIER, lexeme);
 }
 
 Token Scanner::scanNumber() {
@@ -115,13 +247,12 @@ Token Scanner::scanNumber() {
     }
     
     // Проверяем, что это только число (без точки)
-    string lexeme = input.substr(start, position - start);
+    string lexeme(input.substr(start, position - start));
     return makeToken(TokenType::NUMBER, lexeme);
 }
 
 Token Scanner::scanString() {
-    advance(); // Пропускаем первую кавычку
-    
+    // Открывающая кавычка уже прочитана в getNextToken
     while (!isAtEnd() && peek() != '"') {
         if (peek() == '\\') {
             advance(); // Пропускаем escape-символ
@@ -135,14 +266,19 @@ Token Scanner::scanString() {
     
     advance(); // Пропускаем закрывающую кавычку
     
-    string lexeme = input.substr(start + 1, position - start - 2);
+    string lexeme(input.substr(start + 1, position - start - 2));
     return makeToken(TokenType::STRING_LITERAL, lexeme);
 }
 
 Token Scanner::getNextToken() {
-    skipWhitespace();
+    compact();
+    if (!skipWhitespace()) {
+        return errorToken("Незавершенный комментарий");
+    }
     
     start = position;
+    tokenLine = line;
+    tokenColumn = column;
     
     if (isAtEnd()) {
         return makeToken(TokenType::END_OF_FILE, "");
@@ -163,7 +299,6 @@ Token Scanner::getNextToken() {
     
     // Числа
     if (isdigit(c)) {
-        position--; // Возвращаемся назад, чтобы scanNumber мог начать правильно
         return scanNumber();
     }
     
@@ -176,6 +311,9 @@ Token Scanner::getNextToken() {
 }
 
 Token Scanner::peekToken() {
+    // После compact() повторный вызов внутри getNextToken() буфер не сдвигает,
+    // поэтому сохраненные позиции остаются корректными
+    compact();
     size_t savedPos = position;
     size_t savedLine = line;
     size_t savedCol = column;
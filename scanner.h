@@ -2,8 +2,10 @@
 #define SCANNER_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <fstream>
+#include <functional>
 
 // Типы токенов
 enum class TokenType {
@@ -15,7 +17,7 @@ enum class TokenType {
     PRINT,
     
     // Идентификаторы и константы
-    IDENTIFIER,      // I
+    IDENTIFIER,      // I, J, x1 ... (имя переменной)
     NUMBER,         // N (для номеров case)
     STRING_LITERAL, // "Текст"
     
@@ -43,29 +45,70 @@ struct Token {
         : type(t), lexeme(l), line(ln), column(col) {}
 };
 
+// Источник текста для потокового режима: записывает до capacity байт
+// в buffer и возвращает их число; 0 означает конец ввода
+using ChunkReader = std::function<size_t(char* buffer, size_t capacity)>;
+
 class Scanner {
 public:
     Scanner(const std::string& input);
+    // Текст без копирования: буфер должен жить дольше сканера
+    explicit Scanner(std::string_view text);
     Scanner(std::ifstream& file);
+    // Потоковый режим: текст запрашивается порциями по мере разбора,
+    // уже разобранная часть буфера освобождается
+    Scanner(ChunkReader reader, size_t chunkSize = 64 * 1024);
     ~Scanner();
     
+    Scanner(const Scanner&) = delete;
+    Scanner& operator=(const Scanner&) = delete;
+    
     Token getNextToken();
     Token peekToken();
     bool hasMoreTokens() const;
     void reset();
     
+    // Позиция начала текста в исходном файле (при разборе фрагмента)
+    void setLocation(size_t line, size_t column);
+    
+    // Переход к следующей точке восстановления после ошибки разбора:
+    // ключевому слову case или default либо '}'. Позиции точек собираются
+    // одним проходом по тексту при первом вызове. false — потоковый режим,
+    // в котором текст известен не целиком.
+    bool skipToRecoveryPoint();
+    // Пропуск всего оставшегося текста (исчерпан лимит ошибок)
+    bool skipToEnd();
+
 private:
-    std::string input;
+    std::string buffer;     // собственная копия текста или порции потока
+    std::string_view input; // разбираемый текст: buffer или чужой буфер
     size_t position;
     size_t line;
     size_t column;
     size_t start;
+    // Позиция начала токена (для комментария без конца — его начала)
+    size_t tokenLine = 1;
+    size_t tokenColumn = 1;
+    
+    ChunkReader reader;
+    size_t chunkSize;
+    
+    std::vector<size_t> recoveryPoints; // смещения case, default и '}'
+    bool recoveryIndexed = false;
+    
+    void buildRecoveryIndex();
+    void moveTo(size_t target);
+    
+    bool refill();
+    void compact();
     
     char advance();
-    char peek() const;
-    bool isAtEnd() const;
-    void skipWhitespace();
-    void skipComment();
+    char peek();
+    char peekNext();
+    bool isAtEnd();
+    // false — текст кончился внутри комментария /* без */
+    bool skipWhitespace();
+    bool skipComment();
     
     Token makeToken(TokenType type) const;
     Token makeToken(TokenType type, const std::string& lexeme) const;
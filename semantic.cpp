@@ -1,204 +1,409 @@
 #include "semantic.h"
 #include "error_handler.h"
+#include "trace.h"
 #include <iostream>
 #include <algorithm>
 #include <memory>
+#include <thread>
 
 using namespace std;
 
-SemanticAnalyzer::SemanticAnalyzer() {
-    caseMap.clear();
+// Значение case и его номер в switch
+struct CaseKey {
+    uint32_t key;
+    uint32_t index;
+};
+
+// Устойчивая поразрядная сортировка по значению: четыре прохода по байтам,
+// проход пропускается, если байт у всех значений одинаков
+static void radixSortKeys(vector<CaseKey>& keys) {
+    vector<CaseKey> buffer(keys.size());
+    for (unsigned shift = 0; shift < 32; shift += 8) {
+        size_t counts[256] = {};
+        for (const CaseKey& entry : keys) counts[(entry.key >> shift) & 0xFF]++;
+        if (counts[(keys.empty() ? 0 : keys[0].key >> shift) & 0xFF] == keys.size()) continue;
+        
+        size_t offset = 0;
+        for (size_t& count : counts) {
+            size_t bucket = count;
+            count = offset;
+            offset += bucket;
+        }
+        for (const CaseKey& entry : keys) buffer[counts[(entry.key >> shift) & 0xFF]++] = entry;
+        keys.swap(buffer);
+    }
 }
 
+SemanticAnalyzer::SemanticAnalyzer(ErrorHandler& errors) : errors(errors) {}
+
 void SemanticAnalyzer::analyze(unique_ptr<ASTNode>& ast) {
     if (!ast) return;
     
-    SwitchNode* switchNode = dynamic_cast<SwitchNode*>(ast.get());
-    if (switchNode) {
-        analyzeSwitchNode(switchNode);
+    check(*ast);
+    
+    // Сохраняем скомпилированную форму для выполнения
+    if (!errors.hasErrors()) {
+        compile(*ast);
     }
 }
 
-void SemanticAnalyzer::analyzeSwitchNode(SwitchNode* node) {
+void SemanticAnalyzer::check(const ASTNode& ast) {
+    TRACE_SCOPE("analyze");
+    visitNode(ast, [this](const SwitchNode& node) { analyzeSwitchNode(node); });
+}
+
+void SemanticAnalyzer::compile(const ASTNode& ast) {
+    TRACE_SCOPE("compile");
+    program = Compiler().compile(ast, inputProfile, declaredVariables, profiling);
+    if (profiling) {
+        program.enableProfiling();
+    }
+    compiled = true;
+}
+
+void SemanticAnalyzer::setProfile(const CaseProfile* profile) {
+    inputProfile = profile;
+}
+
+void SemanticAnalyzer::declareVariables(const vector<string>& names) {
+    declaredVariables = names;
+}
+
+void SemanticAnalyzer::enableProfiling() {
+    profiling = true;
+    if (compiled) {
+        program.enableProfiling();
+    }
+}
+
+void SemanticAnalyzer::exportProfile(CaseProfile& profile) const {
+    program.exportProfile(profile);
+}
+
+CompiledProgram SemanticAnalyzer::takeProgram() {
+    compiled = false;
+    return move(program);
+}
+
+void SemanticAnalyzer::setThreadCount(unsigned count) {
+    threadCount = count;
+}
+
+unsigned SemanticAnalyzer::workerCount(size_t caseCount) const {
+    if (!parallel) return 1;
+    unsigned available = threadCount ? threadCount : max(1u, thread::hardware_concurrency());
+    size_t useful = caseCount / PARALLEL_CASES_PER_THREAD;
+    return static_cast<unsigned>(max<size_t>(1, min<size_t>(available, useful)));
+}
+
+void SemanticAnalyzer::analyzeSwitchNode(const SwitchNode& node) {
     // Проверяем переменную
-    if (!validateVariable(node->variable)) {
-        ErrorHandler::getInstance().addError(node->variable,
-            "В операторе switch может использоваться только переменная 'I'");
-    }
-    
-    // Проверяем все case
-    vector<int> caseValues;
-    for (auto& caseNodePtr : node->cases) {
-        CaseNode* caseNode = dynamic_cast<CaseNode*>(caseNodePtr.get());
-        if (caseNode) {
-            analyzeCaseNode(caseNode);
-            
-            // Проверяем уникальность значений case
-            int value = stoi(caseNode->value.lexeme);
-            if (find(caseValues.begin(), caseValues.end(), value) != caseValues.end()) {
-                ErrorHandler::getInstance().addError(caseNode->value,
-                    "Повторяющееся значение case: " + caseNode->value.lexeme);
+    if (!validateVariable(node.variable)) {
+        errors.addError(node.variable,
+            "Ожидается имя переменной в операторе switch");
+    }
+    
+    // Шаблоны print внутри switch могут ссылаться на его переменную
+    enclosingVariables.push_back(node.variable.lexeme);
+    
+    // Проверки отдельных case независимы: на больших switch они идут
+    // параллельно по непрерывным диапазонам, каждая ошибка помечается
+    // номером case, чтобы собрать диагностику в порядке исходного текста
+    size_t caseCount = node.cases.size();
+    unsigned workers = workerCount(caseCount);
+    vector<vector<pair<size_t, Error>>> rangeDiagnostics(workers);
+    
+    if (workers == 1) {
+        analyzeCaseRange(node, 0, caseCount, rangeDiagnostics[0]);
+    } else {
+        // Потоки диапазонов наследуют паузу трассировки вызывающего потока
+        bool paused = !Trace::enabled();
+        vector<thread> threads;
+        for (unsigned w = 0; w < workers; w++) {
+            size_t begin = caseCount * w / workers;
+            size_t end = caseCount * (w + 1) / workers;
+            threads.emplace_back([this, &node, begin, end, &rangeDiagnostics, w, paused] {
+                TracePause pause(paused);
+                analyzeCaseRange(node, begin, end, rangeDiagnostics[w]);
+            });
+        }
+        for (auto& worker : threads) worker.join();
+    }
+    
+    // Уникальность значений case. Хеш-множество вырождается в список, если
+    // значения подобраны кратными числу корзин, поэтому пары (значение,
+    // номер case) сортируются поразрядно: линейное время на любом входе
+    vector<CaseKey> caseValues;
+    caseValues.reserve(caseCount);
+    for (size_t i = 0; i < caseCount; i++) {
+        visitNode(*node.cases[i], [&](const CaseNode& caseNode) {
+            if (validateCaseValue(caseNode)) {
+                caseValues.push_back({static_cast<uint32_t>(caseNode.key), static_cast<uint32_t>(i)});
+            }
+        });
+    }
+    radixSortKeys(caseValues);
+    
+    // Сортировка устойчива: среди равных значений номера case возрастают,
+    // и повтором считается каждое вхождение после первого
+    vector<bool> repeated(caseCount);
+    for (size_t v = 1; v < caseValues.size(); v++) {
+        if (caseValues[v].key == caseValues[v - 1].key) repeated[caseValues[v].index] = true;
+    }
+    vector<pair<size_t, Error>> duplicates;
+    for (size_t i = 0; i < caseCount; i++) {
+        if (!repeated[i]) continue;
+        const auto& caseNode = static_cast<const CaseNode&>(*node.cases[i]);
+        duplicates.emplace_back(i, Error("Повторяющееся значение case: " + caseNode.value.lexeme,
+                                         caseNode.value.line, caseNode.value.column));
+    }
+    
+    // Слияние: диапазоны уже упорядочены, для одного case ошибки
+    // проверок идут раньше ошибки о повторе
+    size_t next = 0;
+    for (const auto& diagnostics : rangeDiagnostics) {
+        for (const auto& entry : diagnostics) {
+            while (next < duplicates.size() && duplicates[next].first < entry.first) {
+                errors.addError(duplicates[next].second.message,
+                                duplicates[next].second.line, duplicates[next].second.column);
+                next++;
             }
-            caseValues.push_back(value);
+            errors.addError(entry.second.message, entry.second.line, entry.second.column);
         }
     }
+    for (; next < duplicates.size(); next++) {
+        errors.addError(duplicates[next].second.message,
+                        duplicates[next].second.line, duplicates[next].second.column);
+    }
     
     // Проверяем default, если есть
-    if (node->defaultCase) {
-        DefaultNode* defaultNode = dynamic_cast<DefaultNode*>(node->defaultCase.get());
-        if (defaultNode) {
+    if (node.defaultCase) {
+        visitNode(*node.defaultCase, [this](const DefaultNode& defaultNode) {
             analyzeDefaultNode(defaultNode);
-        }
+        });
     }
+    enclosingVariables.pop_back();
+}
+
+void SemanticAnalyzer::analyzeCaseRange(const SwitchNode& node, size_t begin, size_t end,
+                                        vector<pair<size_t, Error>>& diagnostics) const {
+    TraceScope scope("analyze range");
+    scope.setArg("cases", end - begin);
     
-    // Сохраняем информацию для выполнения
-    for (auto& caseNodePtr : node->cases) {
-        CaseNode* caseNode = dynamic_cast<CaseNode*>(caseNodePtr.get());
-        if (caseNode) {
-            int value = stoi(caseNode->value.lexeme);
-            vector<string> actions;
-            for (auto& action : caseNode->actions) {
-                PrintNode* printNode = dynamic_cast<PrintNode*>(action.get());
-                if (printNode) {
-                    actions.push_back(printNode->text.lexeme);
-                }
-            }
-            caseMap[value] = actions;
+    // Отдельный анализатор со своим ErrorHandler: потоки не разделяют состояние
+    ErrorHandler rangeErrors;
+    SemanticAnalyzer rangeAnalyzer(rangeErrors);
+    rangeAnalyzer.parallel = false;
+    rangeAnalyzer.enclosingVariables = enclosingVariables;
+    
+    for (size_t i = begin; i < end; i++) {
+        size_t before = rangeErrors.getErrors().size();
+        visitNode(*node.cases[i], [&](const CaseNode& caseNode) {
+            rangeAnalyzer.analyzeCaseNode(caseNode);
+        });
+        const auto& found = rangeErrors.getErrors();
+        for (size_t e = before; e < found.size(); e++) {
+            diagnostics.emplace_back(i, found[e]);
         }
     }
 }
 
-void SemanticAnalyzer::analyzeCaseNode(CaseNode* node) {
+void SemanticAnalyzer::analyzeCaseNode(const CaseNode& node) {
     // Проверяем значение case
-    if (!validateCaseValue(node->value)) {
-        ErrorHandler::getInstance().addError(node->value,
-            "Недопустимое значение case: " + node->value.lexeme);
+    if (!validateCaseValue(node)) {
+        errors.addError(node.value,
+            "Недопустимое значение case: " + node.value.lexeme);
     }
     
     // Проверяем действия
-    for (auto& action : node->actions) {
-        PrintNode* printNode = dynamic_cast<PrintNode*>(action.get());
-        if (printNode) {
-            analyzePrintNode(printNode);
-        }
-    }
+    analyzeActions(node.actions);
     
-    // Проверяем, что есть хотя бы одно действие
-    if (node->actions.empty()) {
-        ErrorHandler::getInstance().addError(node->value,
+    // Пустой case без break — метка группы, его тело — тело следующего
+    if (node.actions.empty() && node.hasBreak) {
+        errors.addError(node.value,
             "Case должен содержать хотя бы одно действие");
     }
 }
 
-void SemanticAnalyzer::analyzeDefaultNode(DefaultNode* node) {
+void SemanticAnalyzer::analyzeDefaultNode(const DefaultNode& node) {
     // Проверяем действия
-    for (auto& action : node->actions) {
-        PrintNode* printNode = dynamic_cast<PrintNode*>(action.get());
-        if (printNode) {
-            analyzePrintNode(printNode);
-        }
-    }
+    analyzeActions(node.actions);
     
     // Проверяем, что есть хотя бы одно действие
-    if (node->actions.empty()) {
-        ErrorHandler::getInstance().addError(Token(), 
+    if (node.actions.empty()) {
+        errors.addError(Token(), 
             "Default должен содержать хотя бы одно действие");
     }
 }
 
-void SemanticAnalyzer::analyzePrintNode(PrintNode* node) {
+void SemanticAnalyzer::analyzePrintNode(const PrintNode& node) {
     // Проверяем, что строка не пустая
-    if (node->text.lexeme.empty()) {
-        ErrorHandler::getInstance().addError(node->text,
+    if (node.text.lexeme.empty()) {
+        errors.addError(node.text,
             "Строка в print() не может быть пустой");
     }
+    
+    vector<TemplatePart> parts;
+    if (node.text.lexeme.find('{') == string::npos ||
+        !splitTemplate(node.text.lexeme, enclosingVariables, parts)) {
+        return;
+    }
+    
+    // Шаблон выводится через буфер ограниченного размера
+    if (templateLength(parts) > CompiledTemplate::MAX_LENGTH) {
+        errors.addError(node.text,
+            "Шаблон в print() длиннее " + to_string(CompiledTemplate::MAX_LENGTH) +
+            " байт после подстановки");
+    }
 }
 
-bool SemanticAnalyzer::validateCaseValue(const Token& token) {
-    if (token.type != TokenType::NUMBER) return false;
-    
-    try {
-        int value = stoi(token.lexeme);
-        return value >= 0; // Можно добавить дополнительные ограничения
-    } catch (...) {
-        return false;
+void SemanticAnalyzer::analyzeActions(const vector<unique_ptr<ASTNode>>& actions) {
+    for (auto& action : actions) {
+        visitNode(*action, Overloaded{
+            [this](const PrintNode& printNode) { analyzePrintNode(printNode); },
+            [this](const SwitchNode& switchNode) { analyzeSwitchNode(switchNode); }
+        });
     }
 }
 
+bool SemanticAnalyzer::validateCaseValue(const CaseNode& node) {
+    return node.value.type == TokenType::NUMBER && node.hasKey && node.key >= 0;
+}
+
 bool SemanticAnalyzer::validateVariable(const Token& token) {
-    return token.type == TokenType::IDENTIFIER && token.lexeme == "I";
+    return token.type == TokenType::IDENTIFIER && !token.lexeme.empty();
 }
 
-void SemanticAnalyzer::execute(unique_ptr<ASTNode>& ast, int switchValue) {
-    if (!ast) {
-        cout << "Ошибка: AST пуст\n";
-        return;
+// Вывод хода выполнения на консоль; вложенные switch выводятся с отступом
+struct ConsoleSink {
+    void onCase(const CompiledProgram& program, const CompiledSwitch& node,
+                uint32_t keyIndex, int depth) {
+        cout << string(depth * 2, ' ') << "Выполняется case " << node.dispatcher.key(keyIndex);
+        printVariable(program, node, depth);
     }
     
-    SwitchNode* switchNode = dynamic_cast<SwitchNode*>(ast.get());
-    if (switchNode) {
-        executeSwitchNode(switchNode, switchValue);
+    void onDefault(const CompiledProgram& program, const CompiledSwitch& node, int depth) {
+        cout << string(depth * 2, ' ') << "Выполняется default";
+        printVariable(program, node, depth);
     }
-}
-
-void SemanticAnalyzer::executeSwitchNode(SwitchNode* node, int switchValue) {
-    cout << "\n=== ВЫПОЛНЕНИЕ SWITCH ===" << endl;
-    cout << "Значение переменной I = " << switchValue << endl;
-    
-    bool caseFound = false;
-    
-    // Ищем подходящий case
-    for (auto& caseNodePtr : node->cases) {
-        CaseNode* caseNode = dynamic_cast<CaseNode*>(caseNodePtr.get());
-        if (caseNode) {
-            int caseValue = stoi(caseNode->value.lexeme);
-            if (caseValue == switchValue) {
-                caseFound = true;
-                executeCaseNode(caseNode, caseValue);
-                break;
-            }
-        }
+    
+    void onNoMatch(const CompiledProgram& program, const CompiledSwitch& node, int depth) {
+        cout << string(depth * 2, ' ') << "Не найден подходящий case и отсутствует default";
+        if (depth > 0) cout << " (" << program.variables[node.variable] << ")";
+        cout << endl;
     }
     
-    // Если case не найден, выполняем default
-    if (!caseFound && node->defaultCase) {
-        DefaultNode* defaultNode = dynamic_cast<DefaultNode*>(node->defaultCase.get());
-        if (defaultNode) {
-            cout << "Выполняется default:" << endl;
-            for (auto& action : defaultNode->actions) {
-                PrintNode* printNode = dynamic_cast<PrintNode*>(action.get());
-                if (printNode) {
-                    executePrintNode(printNode);
-                }
-            }
-        }
-    } else if (!caseFound) {
-        cout << "Не найден подходящий case и отсутствует default\n";
+    void onOutput(string_view text, int depth) {
+        cout << string(depth * 2 + 2, ' ') << "Вывод: " << text << endl;
     }
-}
+    
+    // Для вложенных switch уточняем, по какой переменной сделан выбор
+    static void printVariable(const CompiledProgram& program, const CompiledSwitch& node, int depth) {
+        if (depth > 0) cout << " (" << program.variables[node.variable] << ")";
+        cout << ":" << endl;
+    }
+};
 
-void SemanticAnalyzer::executeCaseNode(CaseNode* node, int caseValue) {
-    cout << "Выполняется case " << caseValue << ":" << endl;
-    for (auto& action : node->actions) {
-        PrintNode* printNode = dynamic_cast<PrintNode*>(action.get());
-        if (printNode) {
-            executePrintNode(printNode);
+vector<int32_t> SemanticAnalyzer::valueTuple(int switchValue, const VariableValues& values) const {
+    vector<int32_t> tuple(program.variables.size(), DEFAULT_VALUE);
+    for (size_t i = 0; i < program.variables.size(); i++) {
+        const string& name = program.variables[i];
+        auto it = values.find(name);
+        if (it != values.end()) {
+            tuple[i] = it->second;
+        } else if (name == "I") {
+            tuple[i] = switchValue;
         }
     }
+    return tuple;
 }
 
-void SemanticAnalyzer::executePrintNode(PrintNode* node) {
-    cout << "  Вывод: " << node->text.lexeme << endl;
+void SemanticAnalyzer::execute(unique_ptr<ASTNode>& ast, int switchValue, const VariableValues& values) {
+    if (!ast) {
+        cout << "Ошибка: AST пуст\n";
+        return;
+    }
+    
+    if (!compiled) {
+        compile(*ast);
+    }
+    
+    TRACE_SCOPE("evaluate");
+    
+    vector<int32_t> tuple = valueTuple(switchValue, values);
+    
+    cout << "\n=== ВЫПОЛНЕНИЕ SWITCH ===" << endl;
+    for (size_t i = 0; i < program.variables.size(); i++) {
+        cout << "Значение переменной " << program.variables[i] << " = " << tuple[i] << endl;
+    }
+    
+    ConsoleSink sink;
+    Latency::measure([&](LatencySample* sample) {
+        program.evaluate(tuple.data(), sink, sample);
+    });
 }
 
 void SemanticAnalyzer::printSymbolTable() const {
     cout << "\n=== ТАБЛИЦА СИМВОЛОВ ===" << endl;
-    for (const auto& entry : caseMap) {
-        cout << "Case " << entry.first << ": ";
-        for (const auto& action : entry.second) {
-            cout << "print(\"" << action << "\") ";
+    cout << "Переменные:";
+    for (const auto& name : program.variables) {
+        cout << " " << name;
+    }
+    cout << endl;
+    
+    // Тело выводится как последовательность print и ссылок на узлы switch
+    auto printBody = [this](uint32_t bodyIndex) {
+        const CompiledBody& body = program.bodies[bodyIndex];
+        for (uint32_t i = 0; i < body.actionCount; i++) {
+            const CompiledAction& action = program.actions[body.firstAction + i];
+            if (action.kind == CompiledAction::OUTPUT) {
+                cout << "print(\"" << program.output(action.index) << "\") ";
+            } else if (action.kind == CompiledAction::TEMPLATE) {
+                const CompiledTemplate& compiled = program.templates[action.index];
+                cout << "print(\"";
+                for (uint32_t s = 0; s < compiled.segmentCount; s++) {
+                    const CompiledSegment& segment = program.segments[compiled.firstSegment + s];
+                    if (segment.kind == CompiledSegment::LITERAL) {
+                        cout << program.output(segment.index);
+                    } else {
+                        cout << "{" << program.variables[segment.index] << "}";
+                    }
+                }
+                cout << "\") ";
+            } else {
+                cout << "switch#" << action.index << " ";
+            }
         }
         cout << endl;
+    };
+    
+    for (uint32_t s = 0; s < program.switches.size(); s++) {
+        const CompiledSwitch& node = program.switches[s];
+        cout << "switch#" << s << " (" << program.variables[node.variable] << ")"
+             << (s == program.root ? " [корень]" : "") << endl;
+        for (uint32_t i = 0; i < node.dispatcher.size(); i++) {
+            cout << "Case " << node.dispatcher.key(i) << ": ";
+            printBody(node.caseBodies[i]);
+        }
+        if (node.defaultBody != CompiledSwitch::NO_BODY) {
+            cout << "Default: ";
+            printBody(node.defaultBody);
+        }
+    }
+    
+    // Тела групп меток и case без break — суффиксы общих отрезков
+    size_t bodyActions = 0;
+    for (const CompiledBody& body : program.bodies) {
+        bodyActions += body.actionCount;
+    }
+    if (bodyActions > program.actions.size()) {
+        cout << "Действий: " << program.actions.size()
+             << " (в телах по отдельности: " << bodyActions << ")" << endl;
+    }
+    
+    if (program.sourceSwitchCount > program.switches.size()) {
+        cout << "Узлов switch: " << program.switches.size()
+             << " (в исходном тексте: " << program.sourceSwitchCount << ")" << endl;
     }
     cout << "========================" << endl;
-}
\ No newline at end of file
+}
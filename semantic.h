@@ -2,32 +2,78 @@
 #define SEMANTIC_H
 
 #include "parser.h"
-#include <unordered_map>
+#include "compiler.h"
+#include "error_handler.h"
 #include <vector>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Значения переменных для выполнения: имя -> значение
+using VariableValues = std::unordered_map<std::string, int>;
 
 class SemanticAnalyzer {
 public:
-    SemanticAnalyzer();
+    static constexpr int DEFAULT_VALUE = 1;
+    
+    SemanticAnalyzer(ErrorHandler& errors = ErrorHandler::getInstance());
     
     void analyze(std::unique_ptr<ASTNode>& ast);
-    void execute(std::unique_ptr<ASTNode>& ast, int switchValue);
+    // Только проверки, без построения скомпилированной формы
+    void check(const ASTNode& ast);
+    // switchValue — значение I; values задает остальные переменные
+    // (и может переопределить I). Незаданные переменные равны DEFAULT_VALUE.
+    void execute(std::unique_ptr<ASTNode>& ast, int switchValue,
+                 const VariableValues& values = VariableValues());
     void printSymbolTable() const;
     
+    // Профиль, по которому упорядочивается выбор case при компиляции
+    void setProfile(const CaseProfile* profile);
+    // Переменные, которые выводятся и получают значения при выполнении,
+    // даже если их switch нет в AST (отложенный разбор)
+    void declareVariables(const std::vector<std::string>& names);
+    // Подсчет попаданий в case при выполнении. Вызывается до analyze:
+    // тогда одинаковые switch не сливаются и считаются раздельно
+    void enableProfiling();
+    void exportProfile(CaseProfile& profile) const;
+    
+    // Передача скомпилированной программы владельцу (после analyze)
+    CompiledProgram takeProgram();
+    const CompiledProgram& getProgram() const { return program; }
+    
+    // Значения переменных в порядке getProgram().variables
+    std::vector<int32_t> valueTuple(int switchValue, const VariableValues& values) const;
+    
+    // Число потоков для проверки case (0 — по числу ядер)
+    void setThreadCount(unsigned count);
+    
+    // Минимум case на поток, при котором проверка распараллеливается
+    static constexpr size_t PARALLEL_CASES_PER_THREAD = 8192;
+
 private:
-    std::unordered_map<int, std::vector<std::string>> caseMap; // номер case -> список действий
+    ErrorHandler& errors;
+    unsigned threadCount = 0;
+    bool parallel = true; // вложенные switch проверяются в потоке внешнего
+    std::vector<std::string_view> enclosingVariables; // переменные объемлющих switch
+    CompiledProgram program; // скомпилированная форма для выполнения
+    bool compiled = false;
+    const CaseProfile* inputProfile = nullptr;
+    std::vector<std::string> declaredVariables;
+    bool profiling = false;
     
-    void analyzeSwitchNode(SwitchNode* node);
-    void analyzeCaseNode(CaseNode* node);
-    void analyzeDefaultNode(DefaultNode* node);
-    void analyzePrintNode(PrintNode* node);
+    void compile(const ASTNode& ast);
     
-    void executeSwitchNode(SwitchNode* node, int switchValue);
-    void executeCaseNode(CaseNode* node, int caseValue);
-    void executePrintNode(PrintNode* node);
+    void analyzeSwitchNode(const SwitchNode& node);
+    void analyzeCaseNode(const CaseNode& node);
+    void analyzeDefaultNode(const DefaultNode& node);
+    void analyzePrintNode(const PrintNode& node);
+    void analyzeActions(const std::vector<std::unique_ptr<ASTNode>>& actions);
+    void analyzeCaseRange(const SwitchNode& node, size_t begin, size_t end,
+                          std::vector<std::pair<size_t, Error>>& diagnostics) const;
+    unsigned workerCount(size_t caseCount) const;
     
-    bool validateCaseValue(const Token& token);
+    bool validateCaseValue(const CaseNode& node);
     bool validateVariable(const Token& token);
 };
 
@@ -0,0 +1,229 @@
+#!/bin/sh
+# Проверка поведения: вывод switch_translator сравнивается с ожидаемым
+# из tests/expected. Использование: tests/check.sh [путь к switch_translator]
+# UPDATE=1 перезаписывает ожидаемый вывод текущим.
+
+T=${1:-./switch_translator}
+DIR=$(dirname "$0")
+failed=0
+
+report() {
+    if [ "$2" = "$3" ]; then
+        echo "  ok   $1"
+    else
+        echo "  FAIL $1"
+        printf '%s\n' "$3" > /tmp/switch_check_actual.$$
+        printf '%s\n' "$2" | diff - /tmp/switch_check_actual.$$ | head -20
+        rm -f /tmp/switch_check_actual.$$
+        failed=1
+    fi
+}
+
+# expect ИМЯ КОМАНДА: stdout и stderr команды совпадают с expected/ИМЯ.txt
+expect() {
+    actual=$(eval "$2" 2>&1)
+    if [ -n "$UPDATE" ]; then
+        printf '%s\n' "$actual" > "$DIR/expected/$1.txt"
+    fi
+    report "$1" "$(cat "$DIR/expected/$1.txt")" "$actual"
+}
+
+# same ИМЯ КОМАНДА1 КОМАНДА2: одинаковый результат выполнения (вывод
+# начиная с заголовка выполнения switch) у двух способов трансляции
+same() {
+    first=$(eval "$2" 2>&1 | sed -n '/=== ВЫПОЛНЕНИЕ SWITCH ===/,$p')
+    second=$(eval "$3" 2>&1 | sed -n '/=== ВЫПОЛНЕНИЕ SWITCH ===/,$p')
+    if [ -z "$first" ]; then
+        first="(нет вывода выполнения)"
+    fi
+    report "$1" "$first" "$second"
+}
+
+echo "Отложенный разбор (--lazy) и полный:"
+for file in examples/example*.txt; do
+    for value in 0 1 2 3 5 7; do
+        same "$(basename "$file" .txt) -v $value" \
+             "$T -v $value -v J=2 $file" "$T --lazy -v $value -v J=2 $file"
+    done
+done
+expect lazy-all-variables "$T --lazy -v 3 examples/example3.txt"
+expect lazy-fallback "$T --lazy tests/lazy-fallback.txt"
+
+# Вычисление в процессах --workers (по образу программы) и в процессе
+# транслятора: запрос "I=1 J=2" соответствует -v I=1 -v J=2
+inprocess() {
+    file=$1
+    shift
+    for query in "$@"; do
+        args=""
+        for assignment in $query; do
+            args="$args -v $assignment"
+        done
+        $T $args "$file" 2>&1 | sed -n 's/^ *Вывод: //p'
+        echo
+    done
+}
+
+workers() {
+    file=$1
+    shift
+    printf '%s\n' "$@" | $T --workers 2 "$file" 2>&1 | tail -n +2
+}
+
+echo "Процессы --workers и вычисление в процессе:"
+for file in examples/example*.txt; do
+    report "$(basename "$file" .txt)" "$(inprocess "$file" 0 1 2 3 7 "I=1 J=2" "I=2 J=3")" \
+           "$(workers "$file" 0 1 2 3 7 "I=1 J=2" "I=2 J=3")"
+done
+# Интервалы вычислений процессов попадают в общий файл --trace
+trace=tests/trace.$$.json
+printf '1\n2\n' | $T --trace "$trace" --workers 2 examples/example3.txt > /dev/null 2>&1
+report "--trace: пачки вычислений процессов" "evaluate batch" \
+       "$(grep -o '"name":"evaluate batch"' "$trace" | head -1 | cut -d'"' -f4)"
+rm -f "$trace"
+report "--max-errors" "$($T --max-errors 1 $DIR/broken.txt | grep '^\[Строка')" \
+       "$($T --max-errors 1 --workers 2 $DIR/broken.txt < /dev/null | grep '^\[Строка')"
+
+echo "Пакетное чтение:"
+# Канал среди файлов пакета: у него нет смещения, текст приходит частями,
+# и неполное чтение не означает конца файла
+fifo=tests/fifo.$$
+mkfifo "$fifo"
+(head -c 20 examples/example1.txt; sleep 0.2; tail -c +21 examples/example1.txt) > "$fifo" &
+report "канал с текстом по частям" "$($T examples/example2.txt examples/example1.txt 2>&1)" \
+       "$($T examples/example2.txt "$fifo" 2>&1 | sed "s#$fifo#examples/example1.txt#")"
+rm -f "$fifo"
+
+echo "Шаблоны print:"
+expect template "$T -s -v 7 -v J=2 examples/example5.txt"
+# Имя не из объемлющих switch и {{ИМЯ}} выводятся как текст; -s
+# показывает литералы шаблона так, как они выводятся
+expect template-unknown "$T -s -v 1 $DIR/template-unknown.txt; $T -v 2 $DIR/template-unknown.txt; $T -v 3 -v J=4 $DIR/template-unknown.txt"
+
+echo "Сканер на границах порций stdin:"
+# Текст подается порциями с паузой между ними: каждая приходит отдельным
+# read(), и граница попадает внутрь лексемы или комментария
+chunks() {
+    for part in "$@"; do
+        printf '%b' "$part"
+        sleep 0.2
+    done
+}
+# Одиночный '/' в конце порции — неизвестный символ, а не зависание
+expect scanner-slash 'chunks "switch (I) {\n    case 1:\n        print(\"a\") /" \
+    ";\n        break;\n    default:\n        print(\"b\");\n}\n" | $T -v 1 -'
+# Порция кончается открывающей кавычкой: пустая строка и строка,
+# начинающаяся с \", разбираются целиком, позиция — у кавычки
+expect scanner-string 'chunks "switch (I) {\n    case 1:\n        print(\"" "\");\n        break;\n" \
+    "    default:\n        print(\"b\");\n}\n" | $T -v 1 -
+chunks "switch (I) {\n    case 1:\n        print(\"" "\\\"в кавычках\\\"\");\n        break;\n" \
+    "    default:\n        print(\"b\");\n}\n" | $T -v 1 -'
+# Число, разрезанное границей, — один токен с колонкой первой цифры
+expect scanner-number 'chunks "switch (I) {\n    case 12:\n        print(\"a\");\n        break;\n    case 1" \
+    "2:\n        print(\"b\");\n        break;\n    default:\n        print(\"c\");\n}\n" | $T -v 1 -'
+# Граница между '/' и '*': завершенный комментарий пропускается,
+# незавершенный — ошибка в позиции его начала
+expect scanner-comment 'chunks "switch (I) {\n    case 1: /" "* комментарий *" "/\n        print(\"a\");\n" \
+    "        break;\n    default: /" "* без конца\n" | $T -v 1 -'
+
+echo "Восстановление после ошибок разбора:"
+# В каждом сломанном case одна ошибка: после нее разбор продолжается
+# со следующего case, default или '}' без каскада сообщений
+expect max-errors-all "$T $DIR/broken.txt"
+expect max-errors-limit "$T --max-errors 2 $DIR/broken.txt"
+report "потоковый разбор находит те же ошибки" "$($T $DIR/broken.txt | grep '^\[Строка')" \
+       "$($T - < $DIR/broken.txt | grep '^\[Строка')"
+# В потоке лимит действует на одну программу, следующая выполняется
+expect max-errors-stream "cat $DIR/broken.txt examples/example1.txt | $T --max-errors 1 -v 1 -"
+
+echo "Группы меток и проваливание:"
+# Результат выполнения для каждого запроса: метки группы ведут в одно
+# тело, без break выполнение продолжается в следующем case, default
+# и после вложенного switch
+run() {
+    file=$1
+    shift
+    for query in "$@"; do
+        $T -v $query "$file" 2>&1 | sed -n '/=== ВЫПОЛНЕНИЕ SWITCH ===/,$p'
+    done
+}
+expect fallthrough-example4 "run examples/example4.txt 1 2 3 4 5 9"
+expect fallthrough-nested "run $DIR/fallthrough.txt '1 -v J=1' '2 -v J=2' '2 -v J=7' 3 4 9"
+for query in "1 -v J=1" "2 -v J=7" 4 9; do
+    same "отложенный разбор -v $query" "$T -v $query $DIR/fallthrough.txt" \
+         "$T --lazy -v $query $DIR/fallthrough.txt"
+done
+report "процессы --workers" "$(inprocess $DIR/fallthrough.txt "I=1 J=1" "I=2 J=7" 3 4 9)" \
+       "$(workers $DIR/fallthrough.txt "I=1 J=1" "I=2 J=7" 3 4 9)"
+
+echo "Интерактивный режим:"
+# Сценарий tests/repl.txt: run со списком и диапазоном, замена case,
+# откат замены, не прошедшей проверку, группа меток без break, time,
+# load, list и use. Время от запуска к запуску разное.
+repl_session() {
+    $T -i < $DIR/repl.txt 2>&1 | sed -E -e 's/[0-9][0-9.e+-]* (мс|нс)/X \1/g' \
+        -e 's/^> [0-9]+ вычислений/> N вычислений/' | sed -n '/^> /,$p'
+}
+expect repl repl_session
+
+echo "Наблюдение (--watch):"
+# Сохранение через переименование пересобирает файл и подменяет программу;
+# после сохранения с ошибкой вычисления идут по предыдущей версии
+watchdir=tests/watch.$$
+mkdir -p "$watchdir"
+mkfifo "$watchdir.in"
+cp examples/example1.txt "$watchdir/program.txt"
+watch_session() {
+    $T --watch -v 1 "$watchdir" < "$watchdir.in" > "$watchdir.out" 2>&1 &
+    pid=$!
+    exec 3> "$watchdir.in"
+    sleep 0.5
+    printf 'switch (I) {\n    case 1:\n        print("Новая версия");\n        break;\n    default:\n        print("-");\n}\n' \
+        > "$watchdir/.program.txt.tmp"
+    mv "$watchdir/.program.txt.tmp" "$watchdir/program.txt"
+    sleep 0.5
+    printf 'switch (I) {\n    case 1:\n        print("Сломана")\n}\n' > "$watchdir/program.txt"
+    sleep 0.5
+    echo 1 >&3
+    sleep 0.5
+    exec 3>&-
+    kill -INT $pid
+    wait $pid
+    # Время пересборки и выполнения от запуска к запуску разное
+    sed -e "s#$watchdir#DIR#g" -e 's/ ([0-9.]* мс:.*) ===$/ ===/' -e '/: выполнение [0-9.]* мс)$/d' \
+        "$watchdir.out"
+}
+expect watch watch_session
+rm -rf "$watchdir" "$watchdir.in" "$watchdir.out"
+
+echo "Трассировка (--trace):"
+# Файл — корректный JSON формата Chrome trace-event, и в нем есть
+# интервалы всех этапов пакетной трансляции
+trace=tests/trace.$$.json
+$T --trace "$trace" -v 2 examples/example1.txt examples/example2.txt > /dev/null 2>&1
+report "корректный JSON" "ok" "$(python3 -m json.tool "$trace" > /dev/null 2>&1 && echo ok)"
+names=$(python3 -c 'import json, sys
+for event in json.load(open(sys.argv[1]))["traceEvents"]:
+    if event["ph"] == "X": print(event["name"])' "$trace" 2>&1 | sort -u)
+for name in parse analyze compile evaluate "io wait"; do
+    report "интервал $name" "$name" "$(printf '%s\n' "$names" | grep -x "$name")"
+done
+rm -f "$trace"
+
+echo "Профиль:"
+# Вложенные switch по J под case 1 и case 2 одинаковы, но попадания
+# в них считаются раздельно, по пути к switch
+profile=tests/profile.$$
+rm -f "$profile"
+record() {
+    for query in "1 -v J=1" "1 -v J=1" "2 -v J=5" "3"; do
+        $T --profile-out "$profile" -v $query examples/example3.txt > /dev/null
+    done
+    cat "$profile"
+}
+expect profile-paths record
+same "профиль не меняет результат" "$T -v 2 -v J=5 examples/example3.txt" \
+     "$T --profile-in $profile -v 2 -v J=5 examples/example3.txt"
+rm -f "$profile"
+
+exit $failed
@@ -0,0 +1,56 @@
+// Проверка Latency при fork(): пока другой поток выводит процентили
+// (и держит блокировку реестра гистограмм), процесс многократно делится,
+// а каждый потомок записывает и выводит свои измерения. Потомок, который
+// унаследовал захваченную блокировку, завис бы навсегда.
+#include "test.h"
+#include "latency.h"
+#include <atomic>
+#include <sstream>
+#include <thread>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+int main() {
+    const int forkCount = 200;
+    
+    Latency::enable();
+    Latency::record(LatencyKind::EVALUATE, 1000);
+    
+    atomic<bool> running{true};
+    thread reporter([&] {
+        while (running.load()) {
+            ostringstream report;
+            Latency::write(report);
+        }
+    });
+    
+    // Зависший потомок не завершится: alarm прерывает проверку
+    alarm(20);
+    int failed = 0;
+    for (int i = 0; i < forkCount; i++) {
+        pid_t child = fork();
+        if (child < 0) {
+            perror("fork");
+            return 1;
+        }
+        if (child == 0) {
+            Latency::afterFork();
+            Latency::record(LatencyKind::EVALUATE, 2000);
+            ostringstream report;
+            Latency::write(report);
+            // Измерения родителя в выводе потомка не повторяются
+            _exit(report.str().find("         1      2000") != string::npos ? 0 : 2);
+        }
+        int status = 0;
+        waitpid(child, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) failed++;
+    }
+    running.store(false);
+    reporter.join();
+    
+    expect(failed == 0, "fork во время вывода задержек (" + to_string(forkCount) +
+           " процессов, ошибок " + to_string(failed) + ")");
+    return testResult();
+}
@@ -0,0 +1,131 @@
+// Проверка ProgramImage: корректный образ принимается и вычисляется так же,
+// как программа в процессе, а образ с испорченными полями отвергается
+// конструктором (иначе вычисление по нему читает за границами или зависает)
+#include "test.h"
+#include "image.h"
+#include <cstring>
+#include <functional>
+#include <sstream>
+
+using namespace std;
+
+// Внешний switch по I с редкими ключами (HASH) и вложенный по J с тремя
+// ключами (LINEAR, неполный блок ключей)
+static string testSource() {
+    ostringstream source;
+    source << "switch (I) {\n";
+    for (int i = 0; i < 64; i++) {
+        source << "    case " << i * 100003 << ":\n        print(\"case " << i << "\");\n        break;\n";
+    }
+    source << "    default:\n        switch (J) {\n"
+           << "            case 1:\n                print(\"J один\");\n                break;\n"
+           << "            case 2:\n                print(\"J два\");\n                break;\n"
+           << "            case 3:\n                print(\"J = {J}\");\n                break;\n"
+           << "            default:\n                print(\"I = {I}\");\n        }\n}\n";
+    return source.str();
+}
+
+static string evaluateImage(const ProgramImage& image, const int32_t* values) {
+    string output;
+    image.evaluate(values, [&](string_view text) {
+        output.append(text);
+        output += '\n';
+    });
+    return output;
+}
+
+static string evaluateProgram(const SwitchProgram& program, const int32_t* values) {
+    char buffer[256];
+    size_t size = program.evaluate(values, buffer, sizeof(buffer));
+    return string(buffer, size);
+}
+
+// Копия образа с изменением, внесенным corrupt
+static bool acceptsCorrupted(const vector<KeyBlock>& storage,
+                             const function<void(unsigned char*, const ImageHeader&)>& corrupt) {
+    vector<KeyBlock> copy = storage;
+    unsigned char* bytes = reinterpret_cast<unsigned char*>(copy.data());
+    ImageHeader header;
+    memcpy(&header, bytes, sizeof(header));
+    corrupt(bytes, header);
+    return ProgramImage(copy.data(), header.size).valid();
+}
+
+static ImageSwitch* findSwitch(unsigned char* bytes, const ImageHeader& header, DispatchKind kind) {
+    ImageSwitch* switches = reinterpret_cast<ImageSwitch*>(bytes + header.switchesOffset);
+    for (uint32_t i = 0; i < header.switchCount; i++) {
+        if (switches[i].kind == static_cast<uint32_t>(kind)) return &switches[i];
+    }
+    cerr << "В образе нет switch нужного вида" << endl;
+    exit(1);
+}
+
+int main() {
+    vector<SwitchDiagnostic> diagnostics;
+    auto program = compileSource(testSource(), diagnostics);
+    if (!program) {
+        cerr << "Ошибка компиляции: " << diagnostics.front().message << endl;
+        return 1;
+    }
+    vector<KeyBlock> storage = ProgramImage::build(program->compiled());
+    const ImageHeader& header = *reinterpret_cast<const ImageHeader*>(storage.data());
+    ProgramImage image(storage.data(), header.size);
+    
+    cout << "Корректный образ:" << endl;
+    expect(image.valid(), "образ принят");
+    
+    int slotI = image.variableIndex("I");
+    int slotJ = image.variableIndex("J");
+    bool same = slotI >= 0 && slotJ >= 0;
+    for (int32_t i : {0, 100003, 6300189, 5, -1}) {
+        for (int32_t j : {1, 3, 7}) {
+            int32_t values[2];
+            values[slotI] = i;
+            values[slotJ] = j;
+            same = same && evaluateImage(image, values) == evaluateProgram(*program, values);
+        }
+    }
+    expect(same, "вычисление по образу совпадает с вычислением в процессе");
+    
+    cout << "Испорченный образ отвергается:" << endl;
+    expect(!acceptsCorrupted(storage, [](unsigned char* bytes, const ImageHeader&) {
+        bytes[0] = 'X';
+    }), "неверная сигнатура");
+    expect(!acceptsCorrupted(storage, [](unsigned char* bytes, const ImageHeader& h) {
+        reinterpret_cast<ImageHeader*>(bytes)->root = h.switchCount;
+    }), "корень за пределами switch");
+    expect(!acceptsCorrupted(storage, [](unsigned char* bytes, const ImageHeader& h) {
+        reinterpret_cast<ImageHeader*>(bytes)->outputOffsetsOffset = static_cast<uint32_t>(h.size);
+    }), "таблица строк за концом образа");
+    expect(!acceptsCorrupted(storage, [](unsigned char* bytes, const ImageHeader& h) {
+        ImageSwitch* node = findSwitch(bytes, h, DispatchKind::LINEAR);
+        node->hotCount = node->keyCount + 1;
+    }), "горячий префикс длиннее числа ключей");
+    expect(!acceptsCorrupted(storage, [](unsigned char* bytes, const ImageHeader& h) {
+        ImageSwitch* node = findSwitch(bytes, h, DispatchKind::LINEAR);
+        reinterpret_cast<KeyBlock*>(bytes + node->keysOffset)->lanes[node->keyCount] = 12345;
+    }), "дополнение блока ключей не повторяет первый ключ");
+    expect(!acceptsCorrupted(storage, [](unsigned char* bytes, const ImageHeader& h) {
+        ImageSwitch* node = findSwitch(bytes, h, DispatchKind::HASH);
+        ImageHashSlot* table = reinterpret_cast<ImageHashSlot*>(bytes + node->tableOffset);
+        for (uint32_t t = 0; t < node->tableSize; t++) {
+            if (table[t].index == CaseDispatcher::NOT_FOUND) table[t].index = 0;
+        }
+    }), "хеш-таблица без пустой ячейки");
+    expect(!acceptsCorrupted(storage, [](unsigned char* bytes, const ImageHeader& h) {
+        ImageSwitch* node = findSwitch(bytes, h, DispatchKind::HASH);
+        node->tableSize = 3;
+    }), "размер хеш-таблицы не степень двойки");
+    expect(!acceptsCorrupted(storage, [](unsigned char* bytes, const ImageHeader& h) {
+        // Единственная ячейка пуста, чтобы проверка пустой ячейки не сработала
+        ImageSwitch* node = findSwitch(bytes, h, DispatchKind::HASH);
+        node->tableSize = 1;
+        reinterpret_cast<ImageHashSlot*>(bytes + node->tableOffset)->index = CaseDispatcher::NOT_FOUND;
+    }), "хеш-таблица из одной ячейки");
+    expect(!acceptsCorrupted(storage, [](unsigned char* bytes, const ImageHeader& h) {
+        ImageSwitch* node = findSwitch(bytes, h, DispatchKind::HASH);
+        reinterpret_cast<uint32_t*>(bytes + node->bodiesOffset)[0] = h.bodyCount;
+    }), "тело case за пределами тел");
+    
+    return testResult();
+}
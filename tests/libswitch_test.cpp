@@ -0,0 +1,141 @@
+// Проверка интерфейса libswitch.a: результат компиляции и диагностика,
+// вычисление в буфер и через callback, измерение по запросу (SwitchTiming)
+// и независимость от --latency и --trace, повторный вход из callback
+// и одновременная работа нескольких потоков
+#include "test.h"
+#include "latency.h"
+#include "trace.h"
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+static const string SOURCE =
+    "switch (I) {\n"
+    "    case 1:\n"
+    "        print(\"один\");\n"
+    "        break;\n"
+    "    case 2:\n"
+    "    case 3:\n"
+    "        print(\"два или три\");\n"
+    "    case 4:\n"
+    "        print(\"до четырех\");\n"
+    "        break;\n"
+    "    default:\n"
+    "        switch (J) {\n"
+    "            case 5:\n"
+    "                print(\"I = {I}, J = {J}\");\n"
+    "                break;\n"
+    "            default:\n"
+    "                print(\"иначе\");\n"
+    "        }\n"
+    "}\n";
+
+static string evaluateValue(const SwitchProgram& program, int value) {
+    char buffer[256];
+    size_t size = program.evaluate(value, buffer, sizeof(buffer));
+    return string(buffer, size);
+}
+
+// Контекст callback, который сам вызывает библиотеку
+struct Reentrant {
+    const SwitchProgram* program;
+    string output;
+    bool nestedOk = true;
+};
+
+static void reentrantCallback(const char* text, size_t length, void* context) {
+    Reentrant& state = *static_cast<Reentrant*>(context);
+    state.output.append(text, length);
+    state.output += '\n';
+    // Вложенное вычисление той же программы и компиляция другой
+    state.nestedOk = state.nestedOk && evaluateValue(*state.program, 1) == "один\n";
+    vector<SwitchDiagnostic> diagnostics;
+    auto other = compileSource("switch (X) { default: print(\"x\"); }", diagnostics);
+    state.nestedOk = state.nestedOk && other && evaluateValue(*other, 1) == "x\n";
+}
+
+int main() {
+    vector<SwitchDiagnostic> diagnostics;
+    auto program = compileSource(SOURCE, diagnostics);
+    
+    cout << "Компиляция:" << endl;
+    expect(program && diagnostics.empty(), "программа без ошибок компилируется");
+    if (!program) return 1;
+    expect(program->variables() == vector<string>({"I", "J"}), "переменные в порядке появления");
+    
+    diagnostics.clear();
+    auto broken = compileSource("switch (I) {\n    case 1:\n        print(\"\");\n        break;\n"
+                                "    case 1:\n        print(\"a\");\n        break;\n"
+                                "    default:\n        print(\"b\");\n}\n", diagnostics);
+    expect(!broken && diagnostics.size() == 2 &&
+           diagnostics[0].message == "Строка в print() не может быть пустой" &&
+           diagnostics[0].line == 3 &&
+           diagnostics[1].message == "Повторяющееся значение case: 1" && diagnostics[1].line == 5,
+           "ошибки возвращаются с позициями, программа не создается");
+    
+    cout << "Вычисление:" << endl;
+    expect(evaluateValue(*program, 1) == "один\n", "case с break");
+    expect(evaluateValue(*program, 2) == "два или три\nдо четырех\n", "группа меток и проваливание");
+    expect(evaluateValue(*program, 9) == "иначе\n", "default и вложенный switch");
+    int32_t values[2] = {7, 5};
+    char buffer[256];
+    size_t size = program->evaluate(values, buffer, sizeof(buffer));
+    expect(string(buffer, size) == "I = 7, J = 5\n", "набор значений и шаблон");
+    char small[4];
+    size = program->evaluate(2, small, sizeof(small));
+    string full = "два или три\nдо четырех\n";
+    expect(size == full.size() && string(small, sizeof(small)) == full.substr(0, sizeof(small)),
+           "усечение вывода возвращает полный размер");
+    
+    cout << "Измерение:" << endl;
+    // Глобальная запись задержек не влияет на вычисления библиотеки:
+    // без SwitchTiming в гистограммы процесса ничего не попадает
+    Latency::enable();
+    evaluateValue(*program, 1);
+    ostringstream report;
+    Latency::write(report);
+    expect(report.str().empty(), "--latency процесса не измеряет вычисления библиотеки");
+    SwitchTiming timing;
+    size = program->evaluate(values, buffer, sizeof(buffer), timing);
+    expect(string(buffer, size) == "I = 7, J = 5\n" && timing.total > 0 &&
+           timing.total == timing.lookup + timing.emit, "SwitchTiming делит время на поиск и вывод");
+    
+    // Этапы компиляции размечены для --trace транслятора, но компиляция
+    // через библиотеку в трассировку процесса не попадает
+    Trace::enable();
+    diagnostics.clear();
+    expect(compileSource(SOURCE, diagnostics) && Trace::serialize().empty(),
+           "--trace процесса не записывает компиляцию библиотекой");
+    {
+        TRACE_SCOPE("host");
+    }
+    expect(!Trace::serialize().empty(), "интервалы самого процесса записываются");
+    
+    cout << "Повторный вход и потоки:" << endl;
+    Reentrant state{program.get(), "", true};
+    program->evaluate(values, reentrantCallback, &state);
+    expect(state.output == "I = 7, J = 5\n" && state.nestedOk, "вызовы библиотеки из callback");
+    
+    const int threadCount = 4;
+    bool threadOk[threadCount] = {};
+    vector<thread> threads;
+    for (int t = 0; t < threadCount; t++) {
+        threads.emplace_back([&, t] {
+            bool ok = true;
+            for (int i = 0; i < 200 && ok; i++) {
+                vector<SwitchDiagnostic> own;
+                auto local = compileSource(SOURCE, own);
+                ok = local && evaluateValue(*local, 3) == "два или три\nдо четырех\n" &&
+                     evaluateValue(*program, 1 + i % 2) == (i % 2 ? "два или три\nдо четырех\n" : "один\n");
+            }
+            threadOk[t] = ok;
+        });
+    }
+    for (auto& worker : threads) worker.join();
+    bool allOk = true;
+    for (bool ok : threadOk) allOk = allOk && ok;
+    expect(allOk, "компиляция и вычисление в " + to_string(threadCount) + " потоках");
+    
+    return testResult();
+}
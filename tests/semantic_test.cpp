@@ -0,0 +1,91 @@
+// Проверка параллельного семантического анализа: ошибки, найденные
+// потоками в разных диапазонах case, собираются в порядке исходного текста
+// и совпадают с результатом последовательной проверки байт в байт;
+// пауза трассировки действует и в потоках диапазонов
+#include "test.h"
+#include "scanner.h"
+#include "parser.h"
+#include "semantic.h"
+#include "error_handler.h"
+#include "trace.h"
+#include <sstream>
+
+using namespace std;
+
+// Больше трех диапазонов по PARALLEL_CASES_PER_THREAD case. Повторы
+// ссылаются на case из другого диапазона, пустые print и ошибки во
+// вложенных switch разбросаны по всем диапазонам.
+static string testSource(size_t caseCount) {
+    ostringstream source;
+    source << "switch (I) {\n";
+    for (size_t i = 0; i < caseCount; i++) {
+        size_t key = i % 997 == 500 ? (i + caseCount / 2) % caseCount : i;
+        source << "    case " << key << ":\n";
+        if (i % 1201 == 7) {
+            source << "        print(\"\");\n";
+        } else if (i % 4099 == 11) {
+            source << "        switch (J) {\n"
+                   << "            case 1:\n                print(\"a\");\n                break;\n"
+                   << "            case 1:\n                print(\"b\");\n                break;\n"
+                   << "            default:\n                print(\"\");\n"
+                   << "        }\n";
+        } else {
+            source << "        print(\"case " << i << "\");\n";
+        }
+        source << "        break;\n";
+    }
+    source << "    default:\n        print(\"иначе\");\n}\n";
+    return source.str();
+}
+
+// Ошибки анализа с заданным числом потоков в виде текста
+static string analyze(const string& source, unsigned threads) {
+    ErrorHandler errors;
+    Scanner scanner(source);
+    Parser parser(scanner, errors);
+    auto ast = parser.parse();
+    if (errors.hasErrors()) return "ошибка разбора";
+    
+    SemanticAnalyzer semantic(errors);
+    semantic.setThreadCount(threads);
+    semantic.analyze(ast);
+    
+    ostringstream report;
+    for (const Error& error : errors.getErrors()) {
+        report << error.line << ':' << error.column << ": " << error.message << '\n';
+    }
+    return report.str();
+}
+
+int main() {
+    const size_t caseCount = SemanticAnalyzer::PARALLEL_CASES_PER_THREAD * 3 + 1000;
+    string source = testSource(caseCount);
+    
+    string serial = analyze(source, 1);
+    string parallel = analyze(source, 3);
+    
+    // Ошибки есть во всех трех диапазонах: у первой и последней строки
+    // ошибок номера из первого и последнего диапазона
+    size_t errorCount = 0;
+    for (char c : serial) errorCount += c == '\n';
+    if (errorCount == 0) serial = "0\n";
+    int firstLine = stoi(serial);
+    int lastLine = stoi(serial.substr(serial.rfind('\n', serial.size() - 2) + 1));
+    int sourceLines = 0;
+    for (char c : source) sourceLines += c == '\n';
+    
+    cout << "Параллельный анализ (" << caseCount << " case, ошибок " << errorCount << "):" << endl;
+    expect(errorCount > 30 && firstLine < sourceLines / 3 && lastLine > sourceLines * 2 / 3,
+           "ошибки разбросаны по всем диапазонам");
+    expect(parallel == serial, "3 потока: ошибки совпадают с последовательной проверкой");
+    expect(analyze(source, 3) == parallel, "повторный запуск дает тот же порядок");
+    
+    Trace::enable();
+    {
+        TracePause pause;
+        analyze(source, 3);
+    }
+    expect(Trace::serialize().empty(), "потоки диапазонов наследуют паузу трассировки");
+    
+    return testResult();
+}
@@ -0,0 +1,29 @@
+#ifndef TESTS_TEST_H
+#define TESTS_TEST_H
+
+// Общие средства тестовых программ make check: проверки с выводом
+// "ok"/"FAIL", код завершения по их итогу и компиляция текста программы
+#include "libswitch.h"
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+inline int failures = 0;
+
+inline void expect(bool condition, const std::string& name) {
+    std::cout << (condition ? "  ok   " : "  FAIL ") << name << std::endl;
+    if (!condition) failures++;
+}
+
+// Код завершения программы: 1, если хотя бы одна проверка не прошла
+inline int testResult() {
+    return failures ? 1 : 0;
+}
+
+inline std::unique_ptr<SwitchProgram> compileSource(const std::string& source,
+                                                    std::vector<SwitchDiagnostic>& diagnostics) {
+    return SwitchProgram::compile(source.data(), source.size(), diagnostics);
+}
+
+#endif // TESTS_TEST_H
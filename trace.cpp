@@ -0,0 +1,218 @@
+#include "trace.h"
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+#include <pthread.h>
+#include <unistd.h>
+
+using namespace std;
+
+atomic<bool> Trace::active{false};
+
+// Завершенный интервал
+struct TraceEvent {
+    const char* name;
+    uint64_t begin;
+    uint64_t end;
+    const char* argName;
+    uint64_t argValue;
+};
+
+// Блок событий. Пишет только поток-владелец; число записанных событий
+// публикуется с release, поэтому чтение не требует блокировки.
+struct TraceChunk {
+    static constexpr size_t CAPACITY = 4096;
+    
+    TraceEvent events[CAPACITY];
+    atomic<size_t> count{0};
+    atomic<TraceChunk*> next{nullptr};
+};
+
+// Буфер одного потока: односвязный список блоков
+struct TraceBuffer {
+    uint32_t threadId;
+    TraceChunk* head;
+    TraceChunk* tail;
+    
+    explicit TraceBuffer(uint32_t id) : threadId(id), head(new TraceChunk), tail(head) {}
+    
+    ~TraceBuffer() {
+        deleteChunks();
+    }
+    
+    // Только при отсутствии пишущих потоков (в потомке после fork)
+    void clear() {
+        deleteChunks();
+        head = tail = new TraceChunk;
+    }
+    
+    void deleteChunks() {
+        for (TraceChunk* chunk = head; chunk;) {
+            TraceChunk* next = chunk->next.load(memory_order_relaxed);
+            delete chunk;
+            chunk = next;
+        }
+    }
+    
+    void append(const TraceEvent& event) {
+        size_t index = tail->count.load(memory_order_relaxed);
+        if (index == TraceChunk::CAPACITY) {
+            TraceChunk* chunk = new TraceChunk;
+            tail->next.store(chunk, memory_order_release);
+            tail = chunk;
+            index = 0;
+        }
+        tail->events[index] = event;
+        tail->count.store(index + 1, memory_order_release);
+    }
+};
+
+// Реестр буферов. Блокировка берется только при первой записи в потоке
+// и при выводе; буферы завершившихся потоков сохраняются до выхода.
+static mutex registryMutex;
+static vector<unique_ptr<TraceBuffer>> registry;
+// События дочерних процессов (Trace::merge)
+static vector<string> mergedEvents;
+
+static TraceBuffer& threadBuffer() {
+    thread_local TraceBuffer* buffer = nullptr;
+    if (!buffer) {
+        lock_guard<mutex> lock(registryMutex);
+        registry.push_back(make_unique<TraceBuffer>(static_cast<uint32_t>(registry.size() + 1)));
+        buffer = registry.back().get();
+    }
+    return *buffer;
+}
+
+static chrono::steady_clock::time_point traceEpoch = chrono::steady_clock::now();
+
+// fork() при захваченной блокировке реестра оставил бы ее захваченной
+// в потомке навсегда: обработчики pthread_atfork держат ее на время fork
+static void lockRegistryBeforeFork() {
+    registryMutex.lock();
+}
+
+static void unlockRegistryInParent() {
+    registryMutex.unlock();
+}
+
+static void resetRegistryInChild() {
+    // Буферы остаются (на них указывает thread_local потока, выполнившего
+    // fork), но интервалы родителя потомок родителю не возвращает
+    for (auto& buffer : registry) buffer->clear();
+    mergedEvents.clear();
+    registryMutex.unlock();
+}
+
+void Trace::enable() {
+    traceEpoch = chrono::steady_clock::now();
+    active.store(true, memory_order_relaxed);
+    static once_flag forkHandlers;
+    call_once(forkHandlers, [] {
+        pthread_atfork(lockRegistryBeforeFork, unlockRegistryInParent, resetRegistryInChild);
+    });
+}
+
+uint64_t Trace::now() {
+    return static_cast<uint64_t>(
+        chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - traceEpoch).count());
+}
+
+void Trace::record(const char* name, uint64_t begin, uint64_t end,
+                   const char* argName, uint64_t argValue) {
+    threadBuffer().append(TraceEvent{name, begin, end, argName, argValue});
+}
+
+static void writeJsonString(ostream& out, const char* text) {
+    out << '"';
+    for (const char* c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            out << '\\' << *c;
+        } else if (static_cast<unsigned char>(*c) < 0x20) {
+            out << ' ';
+        } else {
+            out << *c;
+        }
+    }
+    out << '"';
+}
+
+// Время в микросекундах с дробной частью, как ожидает формат
+static void writeMicroseconds(ostream& out, uint64_t nanoseconds) {
+    out << nanoseconds / 1000 << '.';
+    uint64_t fraction = nanoseconds % 1000;
+    out << static_cast<char>('0' + fraction / 100) << static_cast<char>('0' + fraction / 10 % 10)
+        << static_cast<char>('0' + fraction % 10);
+}
+
+// События буферов текущего процесса: строки массива traceEvents через
+// ",\n". pid — номер процесса, чтобы потоки разных процессов не смешивались.
+static void writeEvents(ostream& out) {
+    uint32_t pid = static_cast<uint32_t>(getpid());
+    bool first = true;
+    for (const auto& buffer : registry) {
+        if (buffer->head->count.load(memory_order_acquire) == 0) continue;
+        if (!first) out << ",\n";
+        first = false;
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << buffer->threadId
+            << ",\"args\":{\"name\":\"thread " << buffer->threadId << "\"}}";
+        
+        for (const TraceChunk* chunk = buffer->head; chunk;
+             chunk = chunk->next.load(memory_order_acquire)) {
+            size_t count = chunk->count.load(memory_order_acquire);
+            for (size_t i = 0; i < count; i++) {
+                const TraceEvent& event = chunk->events[i];
+                out << ",\n{\"name\":";
+                writeJsonString(out, event.name);
+                out << ",\"cat\":\"switch\",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << buffer->threadId
+                    << ",\"ts\":";
+                writeMicroseconds(out, event.begin);
+                out << ",\"dur\":";
+                writeMicroseconds(out, event.end - event.begin);
+                if (event.argName) {
+                    out << ",\"args\":{";
+                    writeJsonString(out, event.argName);
+                    out << ':' << event.argValue << '}';
+                }
+                out << '}';
+            }
+        }
+    }
+}
+
+string Trace::serialize() {
+    ostringstream out;
+    lock_guard<mutex> lock(registryMutex);
+    writeEvents(out);
+    return out.str();
+}
+
+void Trace::merge(const string& events) {
+    if (events.empty()) return;
+    lock_guard<mutex> lock(registryMutex);
+    mergedEvents.push_back(events);
+}
+
+bool Trace::write(const string& filename) {
+    ofstream out(filename);
+    if (!out.is_open()) {
+        return false;
+    }
+    
+    lock_guard<mutex> lock(registryMutex);
+    ostringstream own;
+    writeEvents(own);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << own.str();
+    bool first = own.str().empty();
+    for (const string& events : mergedEvents) {
+        if (!first) out << ",\n";
+        first = false;
+        out << events;
+    }
+    out << "\n]}\n";
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,93 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Трассировка этапов трансляции в формате Chrome trace-event (--trace).
+// Каждый поток записывает интервалы в собственный буфер без блокировок;
+// пока трассировка выключена, TRACE_SCOPE стоит одной проверки флага.
+class Trace {
+public:
+    static bool enabled() { return active.load(std::memory_order_relaxed) && !paused; }
+    static void enable();
+    
+    // Приостановка записи в текущем потоке (см. TracePause); возвращает
+    // прежнее состояние
+    static bool pause(bool value) {
+        bool previous = paused;
+        paused = value;
+        return previous;
+    }
+    
+    // Время в наносекундах от включения трассировки
+    static uint64_t now();
+    
+    // Запись завершенного интервала в буфер текущего потока.
+    // name и argName должны жить до вызова write() (обычно это литералы).
+    static void record(const char* name, uint64_t begin, uint64_t end,
+                       const char* argName = nullptr, uint64_t argValue = 0);
+    
+    // Запись всех буферов и принятых событий потомков в файл. Вызывается,
+    // когда потоки, пишущие интервалы, уже завершили работу.
+    static bool write(const std::string& filename);
+    
+    // События процесса для передачи родителю: дочерний процесс после fork()
+    // начинает с пустых буферов, а родитель добавляет полученное через merge()
+    // в свой файл. Процессы различаются полем pid.
+    static std::string serialize();
+    static void merge(const std::string& events);
+
+private:
+    static std::atomic<bool> active;
+    static inline thread_local bool paused = false;
+};
+
+// Интервалы текущего потока не записываются, пока объект существует.
+// Так работа, которую процесс не заказывал (компиляция через libswitch),
+// не попадает в его трассировку.
+class TracePause {
+public:
+    explicit TracePause(bool pause = true) : previous(Trace::pause(pause)) {}
+    ~TracePause() { Trace::pause(previous); }
+    
+    TracePause(const TracePause&) = delete;
+    TracePause& operator=(const TracePause&) = delete;
+
+private:
+    bool previous;
+};
+
+// Интервал от создания до уничтожения объекта
+class TraceScope {
+public:
+    explicit TraceScope(const char* name) : name(Trace::enabled() ? name : nullptr) {
+        if (this->name) begin = Trace::now();
+    }
+    
+    ~TraceScope() {
+        if (name) Trace::record(name, begin, Trace::now(), argName, argValue);
+    }
+    
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+    
+    // Числовой аргумент, отображаемый вместе с интервалом
+    void setArg(const char* key, uint64_t value) {
+        argName = key;
+        argValue = value;
+    }
+
+private:
+    const char* name;
+    uint64_t begin = 0;
+    const char* argName = nullptr;
+    uint64_t argValue = 0;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+
+#endif // TRACE_H
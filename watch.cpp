@@ -0,0 +1,309 @@
+#include "watch.h"
+#include "batch.h"
+#include "scanner.h"
+#include "error_handler.h"
+#include "trace.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <set>
+#include <cerrno>
+#include <cstring>
+#include <csignal>
+#include <unistd.h>
+#include <poll.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+using namespace std;
+
+// События, после которых файл пересобирается или удаляется. IN_MODIFY
+// не используется: при сохранении он приходит много раз за одну запись,
+// а редакторы, сохраняющие через переименование, дают IN_MOVED_TO.
+static const uint32_t WATCH_EVENTS =
+    IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_MOVED_FROM;
+
+static string joinPath(const string& directory, const string& name) {
+    return directory.empty() ? name : directory + "/" + name;
+}
+
+static bool isRegularFile(const string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode);
+}
+
+// Ctrl+C завершает наблюдение штатно (например, чтобы записать трассировку)
+static volatile sig_atomic_t stopRequested = 0;
+
+static void requestStop(int) {
+    stopRequested = 1;
+}
+
+static double elapsedMs(chrono::steady_clock::time_point begin,
+                        chrono::steady_clock::time_point end) {
+    return chrono::duration<double, milli>(end - begin).count();
+}
+
+WatchSession::WatchSession(int value, const VariableValues& variableValues)
+    : switchValue(value), values(variableValues) {
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0) {
+        cerr << "Ошибка: inotify недоступен: " << strerror(errno) << endl;
+    }
+}
+
+WatchSession::~WatchSession() {
+    if (inotifyFd >= 0) {
+        close(inotifyFd);
+    }
+}
+
+bool WatchSession::watchDirectory(const string& directory) {
+    if (inotifyFd < 0) return false;
+    
+    int descriptor = inotify_add_watch(inotifyFd, directory.empty() ? "." : directory.c_str(),
+                                       WATCH_EVENTS);
+    if (descriptor < 0) {
+        cerr << "Ошибка: не удалось наблюдать за " << (directory.empty() ? "." : directory)
+             << ": " << strerror(errno) << endl;
+        return false;
+    }
+    directories[descriptor] = directory;
+    return true;
+}
+
+bool WatchSession::addPath(const string& path) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        cerr << "Ошибка: не удалось открыть " << path << endl;
+        return false;
+    }
+    
+    if (S_ISDIR(info.st_mode)) {
+        // Каталог: наблюдаются все файлы в нем, в том числе новые
+        string directory = path;
+        while (directory.size() > 1 && directory.back() == '/') directory.pop_back();
+        if (!watchDirectory(directory)) return false;
+        watchedDirectories.push_back(directory);
+        
+        DIR* handle = opendir(directory.c_str());
+        if (!handle) return false;
+        vector<string> names;
+        while (dirent* entry = readdir(handle)) {
+            if (isProgramName(entry->d_name)) names.push_back(entry->d_name);
+        }
+        closedir(handle);
+        
+        sort(names.begin(), names.end());
+        for (const string& name : names) {
+            string file = joinPath(directory, name);
+            if (isRegularFile(file)) rebuild(file);
+        }
+        return true;
+    }
+    
+    // Файл: наблюдается содержащий его каталог, потому что многие редакторы
+    // сохраняют через новый файл и переименование
+    size_t slash = path.rfind('/');
+    string directory = slash == string::npos ? "" : path.substr(0, slash);
+    if (!watchDirectory(directory)) return false;
+    explicitFiles.push_back(path);
+    rebuild(path);
+    return true;
+}
+
+void WatchSession::rebuild(const string& path) {
+    auto begin = chrono::steady_clock::now();
+    
+    string source;
+    {
+        TRACE_SCOPE("read file");
+        ifstream input(path, ios::binary);
+        if (!input.is_open()) {
+            cerr << "Ошибка: не удалось открыть файл " << path << endl;
+            return;
+        }
+        ostringstream content;
+        content << input.rdbuf();
+        source = content.str();
+    }
+    
+    // Сохранение без изменений (или повторное событие) не пересобирает файл
+    auto existing = files.find(path);
+    if (existing != files.end() && existing->second.source == source) {
+        return;
+    }
+    
+    auto readEnd = chrono::steady_clock::now();
+    
+    ErrorHandler errors;
+    Scanner scanner(source);
+    Parser parser(scanner, errors);
+    auto ast = parser.parse();
+    auto parseEnd = chrono::steady_clock::now();
+    
+    auto semantic = make_unique<SemanticAnalyzer>(errors);
+    if (!errors.hasErrors()) {
+        semantic->analyze(ast);
+    }
+    auto analyzeEnd = chrono::steady_clock::now();
+    
+    cout << "=== ПЕРЕСБОРКА: " << path << " (" << elapsedMs(begin, analyzeEnd)
+         << " мс: чтение " << elapsedMs(begin, readEnd)
+         << ", разбор " << elapsedMs(readEnd, parseEnd)
+         << ", анализ " << elapsedMs(parseEnd, analyzeEnd) << ") ===" << endl;
+    
+    if (errors.hasErrors()) {
+        errors.printErrors();
+        if (existing != files.end()) {
+            cout << "Используется предыдущая версия программы" << endl;
+        }
+        cout << endl;
+        return;
+    }
+    
+    // Подмена программы: следующие вычисления используют новую версию
+    WatchedFile& file = files[path];
+    file.source = move(source);
+    file.ast = move(ast);
+    file.semantic = move(semantic);
+    evaluate(path, file);
+}
+
+void WatchSession::evaluate(const string& path, WatchedFile& file) {
+    auto begin = chrono::steady_clock::now();
+    file.semantic->execute(file.ast, switchValue, values);
+    auto end = chrono::steady_clock::now();
+    cout << "(" << path << ": выполнение " << elapsedMs(begin, end) << " мс)\n" << endl;
+}
+
+void WatchSession::handleEvents() {
+    alignas(inotify_event) char buffer[16 * 1024];
+    
+    // Пакет событий сводится к множеству файлов, каждый пересобирается один раз
+    set<string> changed;
+    set<string> removed;
+    while (true) {
+        ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+        if (length <= 0) break;
+        
+        for (char* pointer = buffer; pointer < buffer + length;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(pointer);
+            pointer += sizeof(inotify_event) + event->len;
+            
+            auto directory = directories.find(event->wd);
+            if (directory == directories.end() || event->len == 0) continue;
+            
+            string name = event->name;
+            string path = joinPath(directory->second, name);
+            bool wanted = find(explicitFiles.begin(), explicitFiles.end(), path) != explicitFiles.end() ||
+                          (isProgramName(name) &&
+                           find(watchedDirectories.begin(), watchedDirectories.end(),
+                                directory->second) != watchedDirectories.end());
+            if (!wanted) continue;
+            
+            if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                changed.erase(path);
+                removed.insert(path);
+            } else {
+                removed.erase(path);
+                changed.insert(path);
+            }
+        }
+    }
+    
+    for (const string& path : removed) {
+        if (files.erase(path)) {
+            cout << "=== УДАЛЕН: " << path << " ===\n" << endl;
+        }
+    }
+    for (const string& path : changed) {
+        // IN_CREATE приходит до записи содержимого; пустой новый файл
+        // будет пересобран по следующему IN_CLOSE_WRITE
+        if (isRegularFile(path)) rebuild(path);
+    }
+}
+
+void WatchSession::handleInput(const string& line) {
+    istringstream words(line);
+    string word;
+    int newValue = switchValue;
+    VariableValues newValues = values;
+    bool any = false;
+    
+    while (words >> word) {
+        try {
+            size_t equals = word.find('=');
+            if (equals == string::npos) {
+                newValue = stoi(word);
+            } else {
+                newValues[word.substr(0, equals)] = stoi(word.substr(equals + 1));
+            }
+            any = true;
+        } catch (...) {
+            cerr << "Ошибка: некорректное значение " << word << endl;
+            return;
+        }
+    }
+    if (!any) return;
+    
+    switchValue = newValue;
+    values = move(newValues);
+    
+    TRACE_SCOPE("evaluate batch");
+    for (auto& [path, file] : files) {
+        cout << "=== " << path << " ===" << endl;
+        evaluate(path, file);
+    }
+}
+
+int WatchSession::run() {
+    if (inotifyFd < 0) return 1;
+    
+    cout << "Наблюдение за изменениями (Ctrl+C для завершения). "
+         << "Введите N или X=N, чтобы вычислить программы с новыми значениями.\n" << endl;
+    
+    // Без SA_RESTART: сигнал прерывает poll()
+    struct sigaction action = {};
+    action.sa_handler = requestStop;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    
+    pollfd descriptors[2] = {{inotifyFd, POLLIN, 0}, {STDIN_FILENO, POLLIN, 0}};
+    string pending;
+    
+    while (!stopRequested) {
+        if (poll(descriptors, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            cerr << "Ошибка: poll: " << strerror(errno) << endl;
+            return 1;
+        }
+        
+        if (descriptors[0].revents & POLLIN) {
+            handleEvents();
+        }
+        
+        if (descriptors[1].revents & (POLLIN | POLLHUP)) {
+            char buffer[4096];
+            ssize_t length = read(STDIN_FILENO, buffer, sizeof(buffer));
+            if (length <= 0) {
+                // stdin закрыт: продолжаем только наблюдение
+                descriptors[1].fd = -1;
+                continue;
+            }
+            pending.append(buffer, static_cast<size_t>(length));
+            
+            size_t newline;
+            while ((newline = pending.find('\n')) != string::npos) {
+                handleInput(pending.substr(0, newline));
+                pending.erase(0, newline + 1);
+            }
+        }
+    }
+    
+    signal(SIGINT, SIG_DFL);
+    return 0;
+}
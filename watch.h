@@ -0,0 +1,55 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include "parser.h"
+#include "semantic.h"
+
+// Режим наблюдения (--watch): файлы и каталоги отслеживаются через inotify,
+// изменившийся файл пересобирается, и новая программа заменяет старую
+// для всех последующих вычислений. Пересобираются только файлы, текст
+// которых действительно изменился; при ошибках остается прежняя версия.
+class WatchSession {
+public:
+    WatchSession(int switchValue, const VariableValues& values);
+    ~WatchSession();
+    
+    WatchSession(const WatchSession&) = delete;
+    WatchSession& operator=(const WatchSession&) = delete;
+    
+    // Добавление файла или каталога (все обычные файлы в нем)
+    bool addPath(const std::string& path);
+    
+    // Цикл ожидания событий. Строка из stdin ("N" или "X=N ...")
+    // задает новые значения и вычисляет все программы.
+    int run();
+
+private:
+    // Скомпилированная версия файла
+    struct WatchedFile {
+        std::string source;
+        std::unique_ptr<ASTNode> ast;
+        std::unique_ptr<SemanticAnalyzer> semantic;
+    };
+    
+    bool watchDirectory(const std::string& directory);
+    void rebuild(const std::string& path);
+    void evaluate(const std::string& path, WatchedFile& file);
+    void handleEvents();
+    void handleInput(const std::string& line);
+    
+    int inotifyFd = -1;
+    int switchValue;
+    VariableValues values;
+    
+    std::map<std::string, WatchedFile> files;
+    std::unordered_map<int, std::string> directories; // дескриптор -> каталог
+    std::vector<std::string> explicitFiles;           // файлы, заданные явно
+    std::vector<std::string> watchedDirectories;      // каталоги, заданные явно
+};
+
+#endif // WATCH_H
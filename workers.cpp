@@ -0,0 +1,288 @@
+#include "workers.h"
+#include "image.h"
+#include "scanner.h"
+#include "parser.h"
+#include "latency.h"
+#include "trace.h"
+#include "error_handler.h"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <deque>
+#include <charconv>
+#include <cerrno>
+#include <cstring>
+#include <malloc.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+// socket — fd является сокетом: запись без SIGPIPE, чтобы завершившийся
+// процесс не убивал своего собеседника
+static bool writeAll(int fd, const char* data, size_t length, bool socket = false) {
+    while (length > 0) {
+        ssize_t written = socket ? send(fd, data, length, MSG_NOSIGNAL) : write(fd, data, length);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+        data += written;
+        length -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+static bool readAll(int fd, char* data, size_t length) {
+    while (length > 0) {
+        ssize_t received = read(fd, data, length);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) return false;
+        data += received;
+        length -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+// Кадр: длина (uint32_t) и данные
+static bool sendFrame(int fd, const string& payload) {
+    uint32_t length = static_cast<uint32_t>(payload.size());
+    return writeAll(fd, reinterpret_cast<const char*>(&length), sizeof(length), true) &&
+           writeAll(fd, payload.data(), payload.size(), true);
+}
+
+static bool receiveFrame(int fd, string& payload) {
+    uint32_t length;
+    if (!readAll(fd, reinterpret_cast<char*>(&length), sizeof(length))) return false;
+    payload.resize(length);
+    return readAll(fd, &payload[0], length);
+}
+
+// Разбор запроса "N" или "X=N ..." поверх значений по умолчанию
+static bool parseRequest(string_view line, const ProgramImage& image, int switchSlot,
+                         vector<int32_t>& tuple) {
+    size_t position = 0;
+    while (position < line.size()) {
+        size_t end = line.find(' ', position);
+        if (end == string_view::npos) end = line.size();
+        string_view word = line.substr(position, end - position);
+        position = end + 1;
+        if (word.empty()) continue;
+        
+        size_t equals = word.find('=');
+        int slot = equals == string_view::npos ? switchSlot : image.variableIndex(word.substr(0, equals));
+        string_view digits = equals == string_view::npos ? word : word.substr(equals + 1);
+        
+        int32_t value;
+        auto result = from_chars(digits.data(), digits.data() + digits.size(), value);
+        if (result.ec != errc() || result.ptr != digits.data() + digits.size()) return false;
+        // Переменные, которых нет в программе, не влияют на результат
+        if (slot >= 0) tuple[slot] = value;
+    }
+    return true;
+}
+
+// Дочерний процесс: отвечает на пачки запросов, вычисляя их по образу
+static int serveRequests(int socket, const ProgramImage& image, const vector<int32_t>& defaults) {
+    int switchSlot = image.variableIndex("I");
+    vector<int32_t> tuple;
+    string request;
+    string reply;
+    
+    while (receiveFrame(socket, request)) {
+        TraceScope scope("evaluate batch");
+        uint64_t requestCount = 0;
+        reply.clear();
+        size_t start = 0;
+        while (start < request.size()) {
+            requestCount++;
+            size_t end = request.find('\n', start);
+            if (end == string::npos) end = request.size();
+            
+            tuple = defaults;
+            if (parseRequest(string_view(request).substr(start, end - start), image, switchSlot, tuple)) {
+                Latency::measure([&](LatencySample* sample) {
+                    image.evaluate(tuple.data(), [&](string_view text) {
+                        reply.append(text.data(), text.size());
+                        reply += '\n';
+                    }, sample);
+                });
+            } else {
+                reply += "Ошибка: некорректный запрос\n";
+            }
+            reply += '\n';
+            start = end + 1;
+        }
+        scope.setArg("requests", requestCount);
+        if (!sendFrame(socket, reply)) break;
+    }
+    return 0;
+}
+
+// Пачка запросов: все полные строки, уже доступные в stdin
+static bool readBatch(string& pending, string& batch) {
+    char buffer[64 * 1024];
+    while (pending.find('\n') == string::npos) {
+        ssize_t received = read(STDIN_FILENO, buffer, sizeof(buffer));
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) {
+            // Последняя строка без перевода строки
+            if (pending.empty()) return false;
+            pending += '\n';
+            break;
+        }
+        pending.append(buffer, static_cast<size_t>(received));
+    }
+    
+    size_t last = pending.rfind('\n');
+    batch.assign(pending, 0, last + 1);
+    pending.erase(0, last + 1);
+    return true;
+}
+
+int runWorkerPool(const string& filename, unsigned workerCount,
+                  int switchValue, const VariableValues& values, size_t maxErrors) {
+    ifstream file(filename);
+    if (!file.is_open()) {
+        cerr << "Ошибка: не удалось открыть файл " << filename << endl;
+        return 1;
+    }
+    
+    // AST и скомпилированная программа нужны только до построения образа
+    vector<KeyBlock> storage;
+    vector<int32_t> defaults;
+    {
+        ErrorHandler errors;
+        errors.setMaxErrors(maxErrors);
+        Scanner scanner(file);
+        Parser parser(scanner, errors);
+        auto ast = parser.parse();
+        SemanticAnalyzer semantic(errors);
+        if (!errors.hasErrors()) {
+            semantic.analyze(ast);
+        }
+        if (errors.hasErrors()) {
+            errors.printErrors();
+            return 1;
+        }
+        defaults = semantic.valueTuple(switchValue, values);
+        storage = ProgramImage::build(semantic.getProgram());
+    }
+    if (storage.empty()) {
+        cerr << "Ошибка: программа слишком велика для образа" << endl;
+        return 1;
+    }
+    size_t imageSize = reinterpret_cast<const ImageHeader*>(storage.data())->size;
+    
+    // Образ в memfd запечатывается: ни один процесс не может его изменить
+    int memfd = memfd_create("switch-image", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memfd < 0 ||
+        !writeAll(memfd, reinterpret_cast<const char*>(storage.data()), imageSize) ||
+        fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) < 0) {
+        cerr << "Ошибка: не удалось создать образ программы: " << strerror(errno) << endl;
+        return 1;
+    }
+    vector<KeyBlock>().swap(storage);
+    
+    // Память AST и компилятора уже освобождена, но остается в куче процесса
+    // и досталась бы каждому дочернему процессу; возвращаем ее системе
+    malloc_trim(0);
+    
+    void* mapped = mmap(nullptr, imageSize, PROT_READ, MAP_SHARED, memfd, 0);
+    close(memfd);
+    if (mapped == MAP_FAILED) {
+        cerr << "Ошибка: не удалось отобразить образ: " << strerror(errno) << endl;
+        return 1;
+    }
+    ProgramImage image(mapped, imageSize);
+    if (!image.valid()) {
+        cerr << "Ошибка: некорректный образ программы" << endl;
+        return 1;
+    }
+    
+    cerr << "Образ программы: " << imageSize << " байт, процессов: " << workerCount << endl;
+    cout.flush();
+    
+    // Отображение образа наследуется дочерними процессами
+    vector<int> sockets;
+    vector<pid_t> workers;
+    for (unsigned w = 0; w < workerCount; w++) {
+        int pair[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) < 0) {
+            cerr << "Ошибка: socketpair: " << strerror(errno) << endl;
+            break;
+        }
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(pair[0]);
+            for (int socket : sockets) close(socket);
+            // Каждый процесс выводит свои задержки (SIGUSR1 — всей группе)
+            Latency::afterFork();
+            int result = serveRequests(pair[1], image, defaults);
+            if (Latency::enabled()) Latency::write(cerr);
+            // Интервалы вычислений попадают в файл --trace родителя
+            if (Trace::enabled()) sendFrame(pair[1], Trace::serialize());
+            _exit(result);
+        }
+        close(pair[1]);
+        if (pid < 0) {
+            cerr << "Ошибка: fork: " << strerror(errno) << endl;
+            close(pair[0]);
+            break;
+        }
+        sockets.push_back(pair[0]);
+        workers.push_back(pid);
+    }
+    
+    // Каждому процессу передается не больше одной пачки, а ответы читаются
+    // в порядке отправки, поэтому вывод идет в порядке запросов
+    deque<size_t> inFlight;
+    string pending;
+    string batch;
+    string reply;
+    int status = workers.empty() ? 1 : 0;
+    
+    for (size_t w = 0; w < sockets.size() && readBatch(pending, batch); w++) {
+        if (sendFrame(sockets[w], batch)) {
+            inFlight.push_back(w);
+        } else {
+            cerr << "Ошибка: процесс " << workers[w] << " не принимает запросы" << endl;
+            status = 1;
+        }
+    }
+    while (!inFlight.empty()) {
+        size_t w = inFlight.front();
+        inFlight.pop_front();
+        if (!receiveFrame(sockets[w], reply)) {
+            cerr << "Ошибка: процесс " << workers[w] << " завершился досрочно" << endl;
+            status = 1;
+            continue;
+        }
+        cout.write(reply.data(), static_cast<streamsize>(reply.size()));
+        cout.flush();
+        
+        if (readBatch(pending, batch)) {
+            if (sendFrame(sockets[w], batch)) {
+                inFlight.push_back(w);
+            } else {
+                cerr << "Ошибка: процесс " << workers[w] << " не принимает запросы" << endl;
+                status = 1;
+            }
+        }
+    }
+    
+    // Конец запросов; в ответ процесс присылает свои интервалы трассировки
+    string events;
+    for (int socket : sockets) {
+        shutdown(socket, SHUT_WR);
+        if (Trace::enabled() && receiveFrame(socket, events)) Trace::merge(events);
+        close(socket);
+    }
+    for (pid_t pid : workers) {
+        int workerStatus;
+        while (waitpid(pid, &workerStatus, 0) < 0 && errno == EINTR) {}
+    }
+    munmap(mapped, imageSize);
+    return status;
+}
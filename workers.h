@@ -0,0 +1,17 @@
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include <string>
+#include "semantic.h"
+
+// Пул процессов-вычислителей (--workers N). Родитель компилирует программу
+// один раз, записывает ее образ (ProgramImage) в memfd и запечатывает его;
+// дочерние процессы отображают образ только для чтения, поэтому память
+// под программу одна на все процессы. Запросы читаются из stdin построчно
+// ("N" или "X=N ...") и раздаются процессам пачками; ответы выводятся
+// в порядке запросов: строки print и пустая строка после каждого запроса.
+// maxErrors — лимит ошибок разбора (--max-errors, 0 — без ограничения).
+int runWorkerPool(const std::string& filename, unsigned workerCount,
+                  int switchValue, const VariableValues& values, size_t maxErrors);
+
+#endif // WORKERS_H